@@ -0,0 +1,417 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+// benchmark
+//
+// Runs every check kernel on a generated scene, on one thread, and prints
+// one JSON object per kernel and line to stdout:
+//
+//   {"kernel":"doubleFace","unit":"faces","items":1000000,"repeat":5,
+//    "bestSec":0.1,"meanSec":0.11,"throughput":1e+07,"found":1000,
+//    "injected":1000,"meshes":100,"facesPerMesh":10000,...}
+//
+// throughput is items per second of the best run. found is what the kernel
+// reported, injected is what the generator put in. curveSamePosition
+// reports both curves of a pair, so it finds about twice the injected.
+//
+//   benchmark [-meshes n] [-faces n] [-curves n] [-cvs n] [-defectRate r]
+//             [-seed n] [-repeat n] [-tolerance d] [-kernel name]... [-obj file]
+//
+// doubleFaceTolerance is doubleFace with -tolerance (default 1e-4), and
+// curveSamePositionTolerance is curveSamePosition with it.
+// faceGeometry computes face centers, normals and areas, on SIMD lanes when
+// the build has them, faceGeometryScalar is the same with the scalar code.
+// Both report the number of zero area faces.
+
+#include <stdio.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../common/curveKernels.h"
+#include "../common/faceGeometry.h"
+#include "../common/meshKernels.h"
+#include "../common/profiler.h"
+#include "../common/sceneGenerator.h"
+
+namespace
+{
+    struct Options
+    {
+        Options() : repeat(5), tolerance(1e-4) {}
+
+        GeneratorOptions generator;
+        unsigned int repeat;
+        double tolerance;
+        std::vector<std::string> kernels;
+        std::string objPath;
+    };
+
+    struct Scene
+    {
+        std::vector<MeshData> meshData;
+        std::vector<MeshView> meshes;
+        std::vector<CurveData> curveData;
+        std::vector<CurveView> curves;
+        GeneratorStats stats;
+        MeshKernelOptions kernelOptions;
+        size_t numFaces = 0;
+        size_t numUVs = 0;
+        size_t numTweaks = 0;
+        size_t numNormals = 0;
+        size_t numCVs = 0;
+    };
+
+    // One kernel run over the whole scene. Returns the number of items found.
+    typedef size_t (*KernelFunc)(const Scene& scene);
+
+    struct Kernel
+    {
+        const char* name;
+        const char* unit;
+        KernelFunc run;
+    };
+
+    size_t runFaceCheck(const Scene& scene, const MeshCheckKind kind, const MeshKernelOptions& kernelOptions = MeshKernelOptions()) {
+        const std::vector<MeshCheckKind> checks(1, kind);
+        const std::vector<unsigned int> uvSets(1, 0);
+        MeshKernelScratch scratch;
+        MeshCheckResult result;
+        size_t found = 0;
+        for (const auto& mesh : scene.meshes) {
+            runMeshKernels(mesh, checks, uvSets, kernelOptions, scratch, result);
+            found += isFaceCheck(kind) ? result.faces[kind].size() : (result.invalid[kind] ? 1 : 0);
+        }
+        return found;
+    }
+
+    size_t runDoubleFace(const Scene& scene) {
+        return runFaceCheck(scene, kMeshDoubleFace);
+    }
+
+    size_t runDoubleFaceTolerance(const Scene& scene) {
+        return runFaceCheck(scene, kMeshDoubleFace, scene.kernelOptions);
+    }
+
+    size_t runUVFlip(const Scene& scene) {
+        return runFaceCheck(scene, kMeshUVFlip);
+    }
+
+    size_t runUVNegative(const Scene& scene) {
+        return runFaceCheck(scene, kMeshUVNegative);
+    }
+
+    size_t runUVFull(const Scene& scene) {
+        return runFaceCheck(scene, kMeshUVFull);
+    }
+
+    size_t runUVTilingOver(const Scene& scene) {
+        return runFaceCheck(scene, kMeshUVTilingOver);
+    }
+
+    size_t runFreeze(const Scene& scene) {
+        return runFaceCheck(scene, kMeshFreeze);
+    }
+
+    size_t runNormalLock(const Scene& scene) {
+        return runFaceCheck(scene, kMeshNormalLock);
+    }
+
+    size_t runFace0Count(const Scene& scene) {
+        return runFaceCheck(scene, kMeshFace0Count);
+    }
+
+    size_t countZeroAreas(const FaceGeometry& geometry) {
+        size_t found = 0;
+        for (const auto& area : geometry.areas) {
+            found += area == 0.0f ? 1 : 0;
+        }
+        return found;
+    }
+
+    size_t runFaceGeometry(const Scene& scene) {
+        FaceGeometry geometry;
+        size_t found = 0;
+        for (const auto& mesh : scene.meshes) {
+            computeFaceGeometry(mesh, geometry);
+            found += countZeroAreas(geometry);
+        }
+        return found;
+    }
+
+    size_t runFaceGeometryScalar(const Scene& scene) {
+        FaceGeometry geometry;
+        size_t found = 0;
+        for (const auto& mesh : scene.meshes) {
+            computeFaceGeometryScalar(mesh, geometry);
+            found += countZeroAreas(geometry);
+        }
+        return found;
+    }
+
+    size_t runCurveSamePosition(const Scene& scene) {
+        std::vector<unsigned int> found;
+        searchCurveSamePosition(scene.curves, found);
+        return found.size();
+    }
+
+    size_t runCurveSamePositionTolerance(const Scene& scene) {
+        CurveMatchOptions matchOptions;
+        matchOptions.tolerance = scene.kernelOptions.tolerance;
+        std::vector<unsigned int> found;
+        searchCurveSamePosition(scene.curves, found, matchOptions);
+        return found.size();
+    }
+
+    size_t runCurveSpans0(const Scene& scene) {
+        std::vector<unsigned int> found;
+        searchCurveSpans0(scene.curves, found);
+        return found.size();
+    }
+
+    const Kernel kernels[] = {
+        { "doubleFace", "faces", runDoubleFace },
+        { "doubleFaceTolerance", "faces", runDoubleFaceTolerance },
+        { "uvFlip", "faces", runUVFlip },
+        { "uvNegative", "faces", runUVNegative },
+        { "uvFull", "faces", runUVFull },
+        { "uvTilingOver", "uvs", runUVTilingOver },
+        { "freeze", "pnts", runFreeze },
+        { "normalLock", "normals", runNormalLock },
+        { "face0Count", "meshes", runFace0Count },
+        { "faceGeometry", "faces", runFaceGeometry },
+        { "faceGeometryScalar", "faces", runFaceGeometryScalar },
+        { "curveSamePosition", "cvs", runCurveSamePosition },
+        { "curveSamePositionTolerance", "cvs", runCurveSamePositionTolerance },
+        { "curveSpans0", "curves", runCurveSpans0 },
+    };
+
+    size_t kernelItems(const Scene& scene, const char* unit) {
+        if (std::strcmp(unit, "faces") == 0) {
+            return scene.numFaces;
+        }
+        if (std::strcmp(unit, "uvs") == 0) {
+            return scene.numUVs;
+        }
+        if (std::strcmp(unit, "pnts") == 0) {
+            return scene.numTweaks;
+        }
+        if (std::strcmp(unit, "normals") == 0) {
+            return scene.numNormals;
+        }
+        if (std::strcmp(unit, "meshes") == 0) {
+            return scene.meshes.size();
+        }
+        if (std::strcmp(unit, "cvs") == 0) {
+            return scene.numCVs;
+        }
+        return scene.curves.size();
+    }
+
+    unsigned int kernelInjected(const Scene& scene, const char* name) {
+        const GeneratorStats& stats = scene.stats;
+        const std::string kernel(name);
+        if (kernel == "doubleFace") return stats.doubleFaces;
+        if (kernel == "doubleFaceTolerance") return stats.doubleFaces;
+        if (kernel == "uvFlip") return stats.flippedUVFaces + stats.unmappedFaces;
+        if (kernel == "uvNegative") return stats.negativeUVFaces;
+        if (kernel == "uvFull") return stats.unmappedFaces;
+        if (kernel == "uvTilingOver") return stats.tilingOverMeshes;
+        if (kernel == "freeze") return stats.freezeMeshes;
+        if (kernel == "normalLock") return stats.normalLockMeshes;
+        if (kernel == "curveSamePosition") return stats.samePositionCurves;
+        if (kernel == "curveSamePositionTolerance") return stats.samePositionCurves;
+        if (kernel == "curveSpans0") return stats.spans0Curves;
+        return 0;
+    }
+
+    void usage() {
+        fprintf(stderr,
+            "usage: benchmark [-meshes n] [-faces n] [-curves n] [-cvs n] [-defectRate r]\n"
+            "                 [-seed n] [-repeat n] [-tolerance d] [-kernel name]... [-obj file]\n"
+            "kernels:");
+        for (const auto& kernel : kernels) {
+            fprintf(stderr, " %s", kernel.name);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    bool parseArgs(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg(argv[i]);
+            if (i + 1 >= argc) {
+                fprintf(stderr, "benchmark: missing value of %s.\n", arg.c_str());
+                return false;
+            }
+            const char* value = argv[++i];
+            if (arg == "-meshes") {
+                options.generator.numMeshes = static_cast<unsigned int>(std::atoi(value));
+            }
+            else if (arg == "-faces") {
+                options.generator.facesPerMesh = static_cast<unsigned int>(std::atoi(value));
+            }
+            else if (arg == "-curves") {
+                options.generator.numCurves = static_cast<unsigned int>(std::atoi(value));
+            }
+            else if (arg == "-cvs") {
+                options.generator.cvsPerCurve = static_cast<unsigned int>(std::atoi(value));
+            }
+            else if (arg == "-defectRate") {
+                options.generator.defectRate = std::atof(value);
+            }
+            else if (arg == "-seed") {
+                options.generator.seed = std::strtoull(value, nullptr, 10);
+            }
+            else if (arg == "-repeat") {
+                options.repeat = std::max(1, std::atoi(value));
+            }
+            else if (arg == "-tolerance") {
+                options.tolerance = std::atof(value);
+            }
+            else if (arg == "-kernel") {
+                options.kernels.push_back(value);
+            }
+            else if (arg == "-obj") {
+                options.objPath = value;
+            }
+            else {
+                fprintf(stderr, "benchmark: unknown flag %s.\n", arg.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool isSelected(const Options& options, const char* name) {
+        if (options.kernels.empty()) {
+            return true;
+        }
+        for (const auto& kernel : options.kernels) {
+            if (kernel == name) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    for (const auto& name : options.kernels) {
+        bool known = false;
+        for (const auto& kernel : kernels) {
+            known |= name == kernel.name;
+        }
+        if (!known) {
+            fprintf(stderr, "benchmark: unknown kernel %s.\n", name.c_str());
+            usage();
+            return 2;
+        }
+    }
+
+    const auto generateStart = Profiler::now();
+
+    Scene scene;
+    scene.kernelOptions.tolerance = options.tolerance;
+    generateMeshes(options.generator, scene.meshData, scene.stats);
+    generateCurves(options.generator, scene.curveData, scene.stats);
+
+    scene.meshes.resize(scene.meshData.size());
+    for (size_t i = 0; i < scene.meshData.size(); ++i) {
+        scene.meshes[i] = scene.meshData[i].view();
+        scene.numFaces += scene.meshes[i].numFaces;
+        scene.numUVs += scene.meshes[i].uvSets[0].numUVs;
+        scene.numTweaks += scene.meshes[i].numTweaks;
+        scene.numNormals += scene.meshes[i].numNormals;
+    }
+    scene.curves.resize(scene.curveData.size());
+    for (size_t c = 0; c < scene.curveData.size(); ++c) {
+        scene.curves[c] = scene.curveData[c].view();
+        scene.numCVs += scene.curves[c].numCVs;
+    }
+
+    fprintf(stderr, "benchmark: generated %zu meshes, %zu faces, %zu curves, %zu cvs in %.3f sec.\n",
+        scene.meshes.size(), scene.numFaces, scene.curves.size(), scene.numCVs, Profiler::seconds(generateStart));
+
+    if (!options.objPath.empty() && !writeObj(options.objPath, scene.meshData)) {
+        fprintf(stderr, "benchmark: could not write %s.\n", options.objPath.c_str());
+        return 1;
+    }
+
+    const GeneratorOptions& generator = options.generator;
+    char config[256];
+    snprintf(config, sizeof(config),
+        "\"meshes\":%u,\"facesPerMesh\":%u,\"curves\":%u,\"cvsPerCurve\":%u,\"defectRate\":%.9g,\"seed\":%llu,\"tolerance\":%.9g",
+        generator.numMeshes, generator.facesPerMesh, generator.numCurves, generator.cvsPerCurve,
+        generator.defectRate, (unsigned long long)generator.seed, options.tolerance);
+
+    for (const auto& kernel : kernels) {
+        if (!isSelected(options, kernel.name)) {
+            continue;
+        }
+
+        double bestSec = 0.0;
+        double totalSec = 0.0;
+        size_t found = 0;
+        for (unsigned int r = 0; r < options.repeat; ++r) {
+            const auto start = Profiler::now();
+            found = kernel.run(scene);
+            const double sec = Profiler::seconds(start);
+            bestSec = r == 0 ? sec : std::min(bestSec, sec);
+            totalSec += sec;
+        }
+
+        const size_t items = kernelItems(scene, kernel.unit);
+        std::string json = "{\"kernel\":";
+        appendJsonString(json, kernel.name);
+        json += ",\"unit\":";
+        appendJsonString(json, kernel.unit);
+        json += ",\"items\":";
+        appendJsonNumber(json, static_cast<double>(items));
+        json += ",\"repeat\":";
+        appendJsonNumber(json, options.repeat);
+        json += ",\"bestSec\":";
+        appendJsonNumber(json, bestSec);
+        json += ",\"meanSec\":";
+        appendJsonNumber(json, totalSec / options.repeat);
+        json += ",\"throughput\":";
+        appendJsonNumber(json, bestSec > 0.0 ? items / bestSec : 0.0);
+        json += ",\"found\":";
+        appendJsonNumber(json, static_cast<double>(found));
+        json += ",\"injected\":";
+        appendJsonNumber(json, kernelInjected(scene, kernel.name));
+        json += ",";
+        json += config;
+        json += "}";
+        printf("%s\n", json.c_str());
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -22,8 +22,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
  */
 #include <stdio.h>
-#include <tuple>
-#include <map>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <vector>
 #include <maya/MFn.h>
 #include <maya/MFnPlugin.h>
 #include <maya/MFnDagNode.h>
@@ -37,12 +39,11 @@ SOFTWARE.
 #include <maya/MArgParser.h>
 #include <maya/MPointArray.h>
 #include <maya/MSelectionList.h>
+#include <maya/MThreadPool.h>
 
-#define CheckDisplayError(STAT,MSG)    \
-    if ( MStatus::kSuccess != STAT ) { \
-        MGlobal::displayError(MSG);\
-        return MStatus::kFailure;      \
-    }
+#include "../common/curveKernels.h"
+#include "../common/dagScope.h"
+#include "../common/threadPoolFor.h"
 
 
 class checkCurveSamePosition : public MPxCommand
@@ -59,7 +60,9 @@ class checkCurveSamePosition : public MPxCommand
     private:
         MSelectionList _beforeSelection;
         MSelectionList _invalid;
+        MStringArray _matches;
         bool _isSelect;
+        bool _isClassify;
 };
 
 checkCurveSamePosition::checkCurveSamePosition() {
@@ -71,6 +74,9 @@ MSyntax checkCurveSamePosition::createSyntax() {
     MSyntax syntax;
 
     syntax.addFlag("-s", "-select", MSyntax::kNoArg);
+    syntax.addFlag("-tol", "-tolerance", MSyntax::kDouble);
+    syntax.addFlag("-cl", "-classify", MSyntax::kNoArg);
+    addDagScopeFlags(syntax);
     return syntax;
 }
 
@@ -87,64 +93,106 @@ MStatus checkCurveSamePosition::doIt(const MArgList& args) {
         _isSelect = false;
     }
 
-    MItDag dagIter(MItDag::kDepthFirst, MFn::kNurbsCurve, &stat);
-    CheckDisplayError(stat, "doIt: could not create dagIter.\n");
-
-    std::map<std::tuple<double, double, double>, MDagPath> check_map{};
-    MPointArray cvPositions;
-    for ( ; !dagIter.isDone(); dagIter.next()) {
-        MDagPath dagPath;
-        stat = dagIter.getPath(dagPath);
-        CheckDisplayError(stat, "doIt: could not get dag path.\n");
+    CurveMatchOptions options;
+    if (argData.isFlagSet("tolerance")) {
+        stat = argData.getFlagArgument("tolerance", 0, options.tolerance);
+        CheckDisplayError(stat, "doIt: could not get tolerance argument data.\n");
+        if (!isValidTolerance(options.tolerance)) {
+            MGlobal::displayError("doIt: tolerance must be 0, or between 1e-12 and the largest double.\n");
+            return MStatus::kInvalidParameter;
+        }
+    }
+    _isClassify = argData.isFlagSet("classify");
+    options.matches = _isClassify;
 
-        MFnDagNode dagNode(dagPath, &stat);
-        CheckDisplayError(stat, "doIt: could not get dag node.\n");
+    DagScope scope;
+    stat = parseDagScopeFlags(argData, scope);
+    CheckDisplayError(stat, "doIt: could not parse scope flags.\n");
 
-        if (dagNode.isIntermediateObject()) {
-            continue;
-        }
+    std::deque<MDagPath> scopePaths;
+    stat = getScopedPaths(scope, MFn::kNurbsCurve, scopePaths);
+    CheckDisplayError(stat, "doIt: could not get curve paths.\n");
 
+    std::vector<MDagPath> curvePaths;
+    for (const auto& dagPath : scopePaths) {
         if (!dagPath.hasFn(MFn::kNurbsCurve) || dagPath.hasFn(MFn::kTransform)) {
             continue;
         }
+        curvePaths.push_back(dagPath);
+    }
 
-        MFnNurbsCurve fnCurve(dagPath, &stat);
-        CheckDisplayError(stat, "doIt: could not create MFnNurbsCurve.\n");
+    stat = MThreadPool::init();
+    CheckDisplayError(stat, "doIt: could not create threadpool.\n");
+
+    // world space cvs of curve ranges in parallel.
+    const unsigned int numCurves = static_cast<unsigned int>(curvePaths.size());
+    const unsigned int numRanges = std::max(1u, std::min(std::max(1u, std::thread::hardware_concurrency()) * 4, numCurves));
+    std::vector<CurveData> curveData(numCurves);
+    std::vector<MStatus> rangeStats(numRanges, MStatus::kSuccess);
+    MThreadPoolFor()(numRanges, [&](unsigned int r) {
+        MStatus& rangeStat = rangeStats[r];
+        MPointArray cvPositions;
+        const unsigned int end = static_cast<unsigned int>((unsigned long long)numCurves * (r + 1) / numRanges);
+        for (unsigned int c = static_cast<unsigned int>((unsigned long long)numCurves * r / numRanges); c < end; ++c) {
+            MFnNurbsCurve fnCurve(curvePaths[c], &rangeStat);
+            CheckErrorBreak(rangeStat, "doIt: could not create MFnNurbsCurve.");
+
+            rangeStat = fnCurve.getCVs(cvPositions, MSpace::kWorld);
+            CheckErrorBreak(rangeStat, "doIt: could not get cv positions.");
+
+            unsigned int numCVs = cvPositions.length();
+            MFnNurbsCurve::Form form = fnCurve.form(&rangeStat);
+            CheckErrorBreak(rangeStat, "doIt: could not get form.");
+
+            if (form == MFnNurbsCurve::kPeriodic) {
+                numCVs -= 3;
+            }
 
-        stat = fnCurve.getCVs(cvPositions, MSpace::kWorld);
-        CheckDisplayError(stat, "doIt: could not get cv positions.\n");
+            std::vector<double>& cvs = curveData[c].cvs;
+            cvs.resize(numCVs * 3);
+            for (unsigned int i = 0; i < numCVs; i++) {
+                const MPoint& cvPosition = cvPositions[i];
+                cvs[i * 3 + 0] = cvPosition.x;
+                cvs[i * 3 + 1] = cvPosition.y;
+                cvs[i * 3 + 2] = cvPosition.z;
+            }
+        }
+    });
+    for (const auto& rangeStat : rangeStats) {
+        CheckDisplayErrorRelease(rangeStat, "doIt: could not get curve cvs.\n");
+    }
 
-        unsigned int numCVs = cvPositions.length();
-        MFnNurbsCurve::Form form = fnCurve.form(&stat);
-        CheckDisplayError(stat, "doIt: could not get form.\n");
+    std::vector<CurveView> curves(numCurves);
+    for (unsigned int c = 0; c < numCurves; ++c) {
+        curves[c] = curveData[c].view();
+    }
 
-        if (form == MFnNurbsCurve::kPeriodic) {
-            numCVs -= 3;
+    CurveMatchScratch scratch;
+    std::vector<unsigned int> found;
+    std::vector<CurveMatch> matches;
+    searchCurveSamePositionSplit(curves, options, numRanges, MThreadPoolFor(), scratch, found, matches);
+    MThreadPool::release();
+
+    // pairs of "curve.cv[i]", or of curve names for a whole curve copy.
+    _matches.clear();
+    auto matchString = [&](const unsigned int c, const int cv) {
+        MString name = curvePaths[c].partialPathName();
+        if (cv >= 0) {
+            name += ".cv[";
+            name += cv;
+            name += "]";
         }
+        return name;
+    };
+    for (const auto& match : matches) {
+        _matches.append(matchString(match.curveA, match.cvA));
+        _matches.append(matchString(match.curveB, match.cvB));
+    }
 
-        for (unsigned int i = 0; i < numCVs; i++) {
-
-            auto cvPosition = cvPositions[i];
-            std::tuple<double, double, double> cvp = 
-                std::make_tuple(cvPosition.x, cvPosition.y, cvPosition.z);
-            if (check_map.count(cvp) == 0) {
-                check_map[cvp] = dagPath;
-            } else {
-                bool hasItem = _invalid.hasItem(dagPath, MObject::kNullObj, &stat);
-                CheckDisplayError(stat, "doIt: could not get hasItem1.\n");
-                if (!hasItem) {
-                    stat = _invalid.add(dagPath);
-                    CheckDisplayError(stat, "doIt: could not add invalid curve1.\n");
-                }
-
-                hasItem = _invalid.hasItem(check_map[cvp], MObject::kNullObj, &stat);
-                CheckDisplayError(stat, "doIt: could not get hasItem2.\n");
-                if (!hasItem) {
-                    stat = _invalid.add(check_map[cvp]);
-                    CheckDisplayError(stat, "doIt: could not add invalid curve2.\n");
-                }
-            }
-        }
+    // found is unique, the list is built once without merging.
+    for (const auto& c : found) {
+        stat = _invalid.add(curvePaths[c], MObject::kNullObj, false);
+        CheckDisplayError(stat, "doIt: could not add invalid curve.\n");
     }
     stat = redoIt();
 
@@ -156,6 +204,10 @@ MStatus checkCurveSamePosition::redoIt() {
         MStatus stat = MGlobal::setActiveSelectionList(_invalid);
         return stat;
     }
+    if (_isClassify) {
+        setResult(_matches);
+        return MStatus::kSuccess;
+    }
     MStringArray results;
     MStatus stat = _invalid.getSelectionStrings(results);
     CheckDisplayError(stat, "redoIt: invalid.getSelectionStrings is failed.\n");
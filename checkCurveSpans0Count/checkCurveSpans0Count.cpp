@@ -22,11 +22,14 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
  */
 #include <stdio.h>
-#include <tuple>
-#include <map>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <vector>
 #include <maya/MFn.h>
 #include <maya/MFnPlugin.h>
 #include <maya/MFnDagNode.h>
+#include <maya/MFnDependencyNode.h>
 #include <maya/MFnNurbsCurve.h>
 #include <maya/MItDag.h>
 #include <maya/MPxCommand.h>
@@ -35,8 +38,13 @@ SOFTWARE.
 #include <maya/MDagPath.h>
 #include <maya/MArgList.h>
 #include <maya/MArgParser.h>
-#include <maya/MPointArray.h>
+#include <maya/MPlug.h>
 #include <maya/MSelectionList.h>
+#include <maya/MThreadPool.h>
+
+#include "../common/curveKernels.h"
+#include "../common/dagScope.h"
+#include "../common/threadPoolFor.h"
 
 
 class checkCurveSpans0Count : public MPxCommand
@@ -66,6 +74,7 @@ MSyntax checkCurveSpans0Count::createSyntax() {
     MSyntax syntax;
 
     syntax.addFlag("-s", "-select", MSyntax::kNoArg);
+    addDagScopeFlags(syntax);
     return syntax;
 }
 
@@ -82,40 +91,81 @@ MStatus checkCurveSpans0Count::doIt(const MArgList& args) {
         _isSelect = false;
     }
 
-    MItDag dagIter(MItDag::kDepthFirst, MFn::kNurbsCurve, &stat);
+    DagScope scope;
+    stat = parseDagScopeFlags(argData, scope);
     CHECK_MSTATUS_AND_RETURN_IT(stat);
 
-    for ( ; !dagIter.isDone(); dagIter.next()) {
-        MDagPath dagPath;
-        stat = dagIter.getPath(dagPath);
-        CHECK_MSTATUS_AND_RETURN_IT(stat);
-
-        MFnDagNode dagNode(dagPath, &stat);
-        CHECK_MSTATUS_AND_RETURN_IT(stat);
-
-        if (dagNode.isIntermediateObject()) {
-            continue;
-        }
+    std::deque<MDagPath> scopePaths;
+    stat = getScopedPaths(scope, MFn::kNurbsCurve, scopePaths);
+    CHECK_MSTATUS_AND_RETURN_IT(stat);
 
+    std::vector<MDagPath> curvePaths;
+    for (const auto& dagPath : scopePaths) {
         if (!dagPath.hasFn(MFn::kNurbsCurve) || dagPath.hasFn(MFn::kTransform)) {
             continue;
         }
+        curvePaths.push_back(dagPath);
+    }
+    const unsigned int numCurves = static_cast<unsigned int>(curvePaths.size());
 
-        MFnNurbsCurve fnCurve(dagPath, &stat);
-        if (stat != MStatus::kSuccess) {
-            stat = _invalid.add(dagPath);
-            CHECK_MSTATUS_AND_RETURN_IT(stat);
-
-            continue;
-        }
+    // every curve is a nurbsCurve node, one spans attribute for all plugs.
+    MObject spansAttr;
+    if (numCurves > 0) {
+        MFnDependencyNode fnNode(curvePaths[0].node(), &stat);
+        CHECK_MSTATUS_AND_RETURN_IT(stat);
 
-        const int numSpans = fnCurve.numSpans(&stat);
+        spansAttr = fnNode.attribute("spans", &stat);
         CHECK_MSTATUS_AND_RETURN_IT(stat);
+    }
+
+    stat = MThreadPool::init();
+    CHECK_MSTATUS_AND_RETURN_IT(stat);
 
-        if (numSpans == 0) {
-            stat = _invalid.add(dagPath);
-            CHECK_MSTATUS_AND_RETURN_IT(stat);
+    // spans of curve ranges in parallel. The spans plug rejects good curves,
+    // MFnNurbsCurve only confirms a plug that reads 0 or fails. A curve that
+    // can not be read is invalid, the other curves are still checked.
+    const unsigned int numRanges = std::max(1u, std::min(std::max(1u, std::thread::hardware_concurrency()) * 4, numCurves));
+    std::vector<CurveView> curves(numCurves);
+    std::vector<unsigned int> numFailed(numRanges, 0);
+    MThreadPoolFor()(numRanges, [&](unsigned int r) {
+        const unsigned int end = static_cast<unsigned int>((unsigned long long)numCurves * (r + 1) / numRanges);
+        for (unsigned int c = static_cast<unsigned int>((unsigned long long)numCurves * r / numRanges); c < end; ++c) {
+            MStatus curveStat;
+            const MPlug spansPlug(curvePaths[c].node(), spansAttr);
+            const int plugSpans = spansPlug.asInt(&curveStat);
+            if (curveStat == MStatus::kSuccess && plugSpans > 0) {
+                curves[c].numSpans = plugSpans;
+                continue;
+            }
+
+            MFnNurbsCurve fnCurve(curvePaths[c], &curveStat);
+            if (curveStat == MStatus::kSuccess) {
+                curves[c].numSpans = fnCurve.numSpans(&curveStat);
+            }
+            if (curveStat != MStatus::kSuccess) {
+                curves[c].numSpans = 0;
+                ++numFailed[r];
+            }
         }
+    });
+    MThreadPool::release();
+
+    unsigned int failed = 0;
+    for (const auto& n : numFailed) {
+        failed += n;
+    }
+    if (failed > 0) {
+        MString message = "doIt: could not read the spans of ";
+        message += failed;
+        message += " curves, they are reported as invalid.";
+        MGlobal::displayWarning(message);
+    }
+
+    std::vector<unsigned int> found;
+    searchCurveSpans0(curves, found);
+    for (const auto& c : found) {
+        stat = _invalid.add(curvePaths[c], MObject::kNullObj, false);
+        CHECK_MSTATUS_AND_RETURN_IT(stat);
     }
     stat = redoIt();
 
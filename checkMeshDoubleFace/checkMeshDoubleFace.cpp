@@ -22,105 +22,16 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
  */
 #include <stdio.h>
-#include <thread>
-#include <vector>
-#include <deque>
-#include <Windows.h>
-#include <unordered_map>
-#include <unordered_set>
-#include <maya/MFn.h>
 #include <maya/MFnPlugin.h>
-#include <maya/MFnDagNode.h>
-#include <maya/MFnMesh.h>
-#include <maya/MItDag.h>
-#include <maya/MItMeshPolygon.h>
 #include <maya/MPxCommand.h>
 #include <maya/MGlobal.h>
 #include <maya/MSyntax.h>
-#include <maya/MDagPath.h>
-#include <maya/MDagPathArray.h>
 #include <maya/MArgList.h>
 #include <maya/MArgParser.h>
-#include <maya/MPointArray.h>
-#include <maya/MIntArray.h>
+#include <maya/MStringArray.h>
 #include <maya/MSelectionList.h>
-#include <maya/MThreadPool.h>
 
-#define CheckDisplayErrorOnly(STAT,MSG)\
-    if ( MStatus::kSuccess != STAT ) { \
-        MGlobal::displayError(MSG);    \
-    }
-
-#define CheckDisplayError(STAT,MSG)    \
-    if ( MStatus::kSuccess != STAT ) { \
-        MGlobal::displayError(MSG);    \
-        return MStatus::kFailure;      \
-    }
-
-#define CheckErrorReturnMThreadRetVal(STAT,MSG) \
-    if ( MStatus::kSuccess != STAT ) {          \
-        cerr << MSG << endl;                    \
-        return (MThreadRetVal)0;                \
-    }
-
-#define CheckErrorBreak(STAT,MSG)       \
-    if ( MStatus::kSuccess != STAT ) {  \
-        cerr << MSG << endl;            \
-        break;                          \
-    }
-
-#define CheckDisplayErrorRelease(STAT,MSG) \
-    if ( MStatus::kSuccess != STAT ) {     \
-        MGlobal::displayError(MSG);        \
-        MThreadPool::release();            \
-        return MStatus::kFailure;          \
-    }
-
-#ifdef _DEBUG
-class Timer
-{
-public:
-	Timer(MStatus* stat = nullptr) {
-		if (stat != nullptr) {
-			restart();
-		}
-		else {
-			*stat = restart();
-		}
-	}
-
-	MStatus restart() {
-		if (!QueryPerformanceFrequency(&_freq)) {
-			return MStatus::kFailure;
-		}
-
-		if (!QueryPerformanceCounter(&_start)) {
-			return MStatus::kFailure;
-		}
-
-		return MStatus::kSuccess;
-	}
-
-	double  elapsed(MStatus* stat = nullptr) {
-		if (!QueryPerformanceCounter(&_end)) {
-			if (stat != nullptr) {
-				*stat = MStatus::kFailure;
-			}
-			return 0.0;
-		}
-
-		if (stat != nullptr) {
-			*stat = MStatus::kSuccess;
-		}
-
-		return (double)(_end.QuadPart - _start.QuadPart) / _freq.QuadPart;
-	}
-private:
-	LARGE_INTEGER _freq;
-	LARGE_INTEGER _start;
-	LARGE_INTEGER _end;
-};
-#endif // _DEBUG
+#include "../common/meshCheck.h"
 
 class checkMeshDoubleFace : public MPxCommand
 {
@@ -136,14 +47,20 @@ public:
 private:
 	MSelectionList _beforeSelection;
 	MSelectionList _invalid;
+	MString _profile;
+	MStringArray _groups;
 	bool _isSelect;
+	bool _isGroups;
 };
 
 checkMeshDoubleFace::checkMeshDoubleFace()
 	:
 	_isSelect(false),
+	_isGroups(false),
 	_beforeSelection(),
-	_invalid()
+	_invalid(),
+	_profile(),
+	_groups()
 {
 }
 
@@ -154,232 +71,17 @@ MSyntax checkMeshDoubleFace::createSyntax() {
 	MSyntax syntax;
 
 	syntax.addFlag("-s", "-select", MSyntax::kNoArg);
+	// returns "mesh.f[a] mesh.f[b]..." per group of double faces.
+	syntax.addFlag("-gr", "-groups", MSyntax::kNoArg);
+	addMeshCheckFlags(syntax);
+	addDoubleFaceFlags(syntax);
 	return syntax;
 }
 
-typedef struct _taskDataTag
-{
-	// step 1
-	std::deque<MDagPath> meshes;
-
-	// step 2
-	MSelectionList invalidList;
-
-	MStatus stat;
-} TaskData;
-
-// step 1
-MStatus getAllMesh(
-	TaskData& taskData // in out
-) {
-	MItDag dagIter(MItDag::kDepthFirst, MFn::kMesh, &taskData.stat);
-	CheckDisplayError(taskData.stat, "getAllMesh: could not create dagIter.\n");
-
-	MDagPath dagPath;
-	for (; !dagIter.isDone(); dagIter.next()) {
-		taskData.stat = dagIter.getPath(dagPath);
-		CheckDisplayError(taskData.stat, "getAllMesh: could not get dag path.\n");
-
-		MFnDagNode dagNode(dagPath, &taskData.stat);
-		CheckDisplayError(taskData.stat, "getAllMesh: could not get dag node.\n");
-
-		if (dagNode.isIntermediateObject()) {
-			continue;
-		}
-
-		MPlug fcPlug = dagNode.findPlug("fc", false, &taskData.stat);
-		CheckDisplayError(taskData.stat, "getAllMesh: could not get fc plug.");
-
-		const auto& fcSize = fcPlug.numElements(&taskData.stat);
-		CheckDisplayError(taskData.stat, "getAllMesh: could not get fc size.");
-
-		if (fcSize == 0) {
-			continue;
-		}
-
-		taskData.meshes.push_back(dagPath);
-	}
-	return taskData.stat;
-}
-
-typedef struct _searchDoubleFaceTdTag {
-	unsigned int    start, end;
-	TaskData* taskData;
-	MSelectionList  invalidList;
-	MStatus         stat;
-} SearchMeshDoubleFaceTdData;
-
-template<typename T>
-void hash_combine(size_t& seed, T const& v) {
-	std::hash<T> primitive_type_hash;
-	seed ^= primitive_type_hash(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-}
-
-namespace std {
-	template<>
-	class hash<MPoint> {
-	public:
-		size_t operator() (const MPoint& p) const {
-			std::size_t seed = 0;
-			hash_combine(seed, p.x);
-			hash_combine(seed, p.y);
-			hash_combine(seed, p.z);
-			//hash_combine(seed, p.w);
-			return seed;
-		}
-	};
-}
-
-MStatus setInvalidFace(const uint& faceId, MItMeshPolygon& itMeshPolygon, const MDagPath& dagPath, MSelectionList& invalidList)
-{
-	int prevIndex;
-	auto stat = itMeshPolygon.setIndex(faceId, prevIndex);
-	if (stat != MStatus::kSuccess) {
-		return stat;
-	}
-
-	MObject component = itMeshPolygon.currentItem(&stat);
-	if (stat != MStatus::kSuccess) {
-		return stat;
-	}
-
-	stat = invalidList.add(dagPath, component);
-	if (stat != MStatus::kSuccess) {
-		return stat;
-	}
-
-	return stat;
-}
-
-// step 2
-MThreadRetVal searchDoubleFaceTd(void* data) {
-	SearchMeshDoubleFaceTdData* td = (SearchMeshDoubleFaceTdData*)data;
-	TaskData* taskData = td->taskData;
-
-	MPointArray pnts;
-	std::unordered_map<MPoint, uint> centers{};
-	std::unordered_map<MPoint, std::unordered_set<MPoint>> centerFacePnts{};
-	for (unsigned int i = td->start; i < td->end; ++i) {
-		const MDagPath& dagPath = taskData->meshes[i];
-
-		MFnMesh fnMesh(dagPath, &td->stat);
-		CheckErrorReturnMThreadRetVal(td->stat, "searchDoubleFaceTd: could not create MFnMesh.\n");
-
-		td->stat = fnMesh.getPoints(pnts, MSpace::kObject);
-		CheckErrorReturnMThreadRetVal(td->stat, "searchDoubleFaceTd: could not get points from MFnMesh.\n");
-
-		MItMeshPolygon itMeshPolygon(dagPath, MObject::kNullObj, &td->stat);
-		CheckErrorReturnMThreadRetVal(td->stat, "searchDoubleFaceTd: could not create MItMeshPolygon.\n");
-
-		const int numPolygons = fnMesh.numPolygons(&td->stat);
-		CheckErrorReturnMThreadRetVal(td->stat, "searchDoubleFaceTd: could not get numPolygons.\n");
-
-		centers.clear();
-		centers.reserve(numPolygons);
-
-		MIntArray vtxIds;
-		for (int faceId = 0; faceId < numPolygons; ++faceId) {
-			td->stat = fnMesh.getPolygonVertices(faceId, vtxIds);
-			CheckErrorReturnMThreadRetVal(td->stat, "searchDoubleFaceTd: could not get polygonVertices.\n");
-
-			MPoint centerPoint(0, 0, 0);
-			std::unordered_set<MPoint> facePnts{};
-			for (unsigned int v = 0; v < vtxIds.length(); ++v) {
-				auto vtxId = static_cast<unsigned int>(vtxIds[v]);
-				centerPoint += pnts[vtxId];
-				facePnts.insert(pnts[vtxId]);
-			}
-			centerPoint = centerPoint / (double)vtxIds.length();
-
-			// 同じ中心座標があれば DoubleFace と判定する
-			auto itCenter = centers.find(centerPoint);
-			auto itFacePnts = centerFacePnts.find(centerPoint);
-			if (itCenter != centers.end()) {
-				// 同じ座標の頂点を持っているか追加で確認する
-				const auto& centerFacePnts = (*itFacePnts).second;
-				if (centerFacePnts.size() != facePnts.size()) {
-					// 要素数が違うなら違うはず
-					continue;
-				}
-				bool isSamePnts = true;
-				for (auto fi = centerFacePnts.cbegin(); fi != centerFacePnts.cend(); fi++) {
-					if (facePnts.count((*fi)) == 0) {
-						isSamePnts = false;
-					}
-				}
-				if (!isSamePnts) {
-					// すべての頂点座標が一致しないなら違うはず
-					continue;
-				}
-
-				// 判定に利用した face も invalidList に入れておく
-				const auto& centerFaceId = (*itCenter).second;
-				td->stat = setInvalidFace(centerFaceId, itMeshPolygon, dagPath, td->invalidList);
-				CheckErrorReturnMThreadRetVal(td->stat, "searchDoubleFaceTd: could not add td->invlidList.\n");
-			}
-			else {
-				centers.insert({ centerPoint, faceId });
-				centerFacePnts.insert({ centerPoint, facePnts });
-			}
-		}
-	}
-
-	return (MThreadRetVal)0;
-}
-
-void searchMeshDoubleFace(void* data, MThreadRootTask* root) {
-	const auto processor_count = std::thread::hardware_concurrency() * 10;
-#ifdef _DEBUG
-	cerr << "processour_count = " << processor_count << ".\n";
-#endif // _DEBUG
-
-	TaskData* taskData = (TaskData*)data;
-
-	unsigned int size;
-	if (processor_count < taskData->meshes.size()) {
-		size = processor_count;
-	}
-	else {
-		size = static_cast<unsigned int>(taskData->meshes.size());
-	}
-
-	std::vector<SearchMeshDoubleFaceTdData> threadData(size);
-
-	float size_f = static_cast<float>(size);
-	float meshLength_f = static_cast<float>(taskData->meshes.size());
-
-	for (unsigned int i = 0; i < size; ++i) {
-		threadData[i].start = static_cast<unsigned int>(meshLength_f / size_f * i);
-		threadData[i].end = static_cast<unsigned int>(meshLength_f / size_f * (i + 1));
-		threadData[i].taskData = taskData;
-		threadData[i].stat = MStatus::kSuccess;
-
-		MThreadPool::createTask(searchDoubleFaceTd, (void*)&threadData[i], root);
-	}
-
-	MThreadPool::executeAndJoin(root);
-
-	for (unsigned int i = 0; i < size; ++i) {
-		if (threadData[i].invalidList.length() > 0) {
-			taskData->stat = taskData->invalidList.merge(threadData[i].invalidList);
-			CheckErrorBreak(taskData->stat, "searchMeshDoubleFace: could not merge invalid list\n");
-		}
-
-		taskData->stat = threadData[i].stat;
-		CheckErrorBreak(taskData->stat, "searchMeshDoubleFace: thread error\n");
-	}
-}
-
 MStatus checkMeshDoubleFace::doIt(const MArgList& args) {
 	MStatus stat = MStatus::kSuccess;
 
-#ifdef _DEBUG
-	Timer timer = Timer(&stat);
-	if (MStatus::kSuccess != stat) {
-		return stat;
-	}
-#endif // _DEBUG
-
+	const auto parseStart = Profiler::now();
 	MArgParser argData(syntax(), args, &stat);
 
 	if (argData.isFlagSet("select")) {
@@ -390,69 +92,57 @@ MStatus checkMeshDoubleFace::doIt(const MArgList& args) {
 		_isSelect = false;
 	}
 
-#ifdef _DEBUG
-	cerr << "parse argData = " << timer.elapsed(&stat) << "sec.\n";
-	CheckDisplayError(stat, "doIt: parse argData timer elapsed error.");
-	stat = timer.restart();
-	CheckDisplayError(stat, "doIt: parse argData timer reset error.");
-#endif // _DEBUG
+	MeshCheckTask taskData;
+	taskData.checks.push_back(kMeshDoubleFace);
 
-	// ======================================================================
-	// step 1
-	TaskData taskData;
-	stat = getAllMesh(taskData);
-	CheckDisplayError(stat, "doIt: getAllMesh.\n");
+	stat = parseMeshCheckFlags(argData, taskData);
+	CheckDisplayError(stat, "doIt: could not parse mesh check flags.");
 
-#ifdef _DEBUG
-	cerr << "getAllMesh = " << timer.elapsed(&stat) << "sec.\n";
-	CheckDisplayError(stat, "doIt: getAllMesh timer elapsed error.");
-	stat = timer.restart();
-	CheckDisplayError(stat, "doIt: getAllMesh timer reset error.");
-#endif // _DEBUG
+	stat = parseDoubleFaceFlags(argData, taskData);
+	CheckDisplayError(stat, "doIt: could not parse double face flags.");
 
-	// ======================================================================
-	// check mesh size.
-	if (taskData.meshes.size() == 0) {
-		stat = redoIt();
-		return stat;
+	_isGroups = argData.isFlagSet("groups");
+	if (_isGroups) {
+		taskData.kernelOptions.doubleFaceGroups = true;
+		if (taskData.useCache) {
+			// the cache keeps faces only.
+			MGlobal::displayWarning("doIt: -cache is ignored with -groups.");
+			taskData.useCache = false;
+		}
 	}
+	taskData.profiler.addStage("parse", parseStart);
 
 	// ======================================================================
-	// Thread init.
-	stat = MThreadPool::init();
-	CheckDisplayError(stat, "doIt: could not create threadpool.\n");
+	// step 1, 2
+	stat = runMeshChecks(taskData);
+	CheckDisplayError(stat, "doIt: runMeshChecks error.");
 
-#ifdef _DEBUG
-	cerr << "MThreadPool = " << timer.elapsed(&stat) << "sec.\n";
-	CheckDisplayError(stat, "doIt: MThreadPool timer elapsed error.");
-	stat = timer.restart();
-	CheckDisplayError(stat, "doIt: MThreadPool timer reset error.");
-#endif // _DEBUG
+	_invalid = taskData.invalidLists[kMeshDoubleFace];
+	_groups = taskData.doubleFaceGroups;
 
-	// ======================================================================
-	// step 2
-	MThreadPool::newParallelRegion(searchMeshDoubleFace, (void*)&taskData);
-	CheckDisplayErrorRelease(taskData.stat, "doIt: countMeshes error.");
-
-#ifdef _DEBUG
-	cerr << "searchMeshDoubleFace = " << timer.elapsed(&stat) << "sec.\n";
-	CheckDisplayError(stat, "doIt: searchMeshDoubleFace timer elapsed error.");
-	stat = timer.restart();
-	CheckDisplayError(stat, "doIt: searchMeshDoubleFace timer reset error.");
-#endif // _DEBUG
-
-	_invalid = taskData.invalidList;
+	if (taskData.profiler.enabled()) {
+		stat = getProfileResult(taskData, _profile);
+		CheckDisplayError(stat, "doIt: could not get profile result.");
+	}
 
 	stat = redoIt();
 
 	return stat;
-	}
+}
 
 MStatus checkMeshDoubleFace::redoIt() {
 	if (_isSelect) {
 		MStatus stat = MGlobal::setActiveSelectionList(_invalid);
 		return stat;
 	}
+	if (_profile.length() > 0) {
+		setResult(_profile);
+		return MStatus::kSuccess;
+	}
+	if (_isGroups) {
+		setResult(_groups);
+		return MStatus::kSuccess;
+	}
 	MStringArray results;
 	MStatus stat = _invalid.getSelectionStrings(results);
 	CheckDisplayError(stat, "redoIt: invalid.getSelectionStrings is failed.\n");
@@ -488,5 +178,6 @@ MStatus uninitializePlugin(MObject obj)
 {
 	MFnPlugin plugin(obj);
 	plugin.deregisterCommand("checkMeshDoubleFace");
+	meshCheckCache().clear();
 	return MS::kSuccess;
 }
@@ -22,25 +22,15 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
  */
 #include <stdio.h>
-#include <thread>
-#include <vector>
-#include <deque>
-#include <Windows.h>
-#include <maya/MString.h>
-#include <maya/MFn.h>
 #include <maya/MFnPlugin.h>
-#include <maya/MFnDagNode.h>
-#include <maya/MFnMesh.h>
-#include <maya/MItDag.h>
 #include <maya/MPxCommand.h>
 #include <maya/MGlobal.h>
 #include <maya/MSyntax.h>
-#include <maya/MDagPath.h>
-#include <maya/MDagPathArray.h>
 #include <maya/MArgList.h>
 #include <maya/MArgParser.h>
 #include <maya/MSelectionList.h>
-#include <maya/MThreadPool.h>
+
+#include "../common/meshCheck.h"
 
 namespace
 {
@@ -49,77 +39,6 @@ namespace
     const char *selectLongArgName = "-select";
 };
 
-#define CheckDisplayError(STAT,MSG)    \
-    if ( MStatus::kSuccess != STAT ) { \
-        MGlobal::displayError(MSG);    \
-        return MStatus::kFailure;      \
-    }
-
-#define CheckErrorReturnMThreadRetVal(STAT,MSG) \
-    if ( MStatus::kSuccess != STAT ) {          \
-        cerr << MSG << endl;                    \
-        return (MThreadRetVal)0;                \
-    }
-
-#define CheckErrorBreak(STAT,MSG)       \
-    if ( MStatus::kSuccess != STAT ) {  \
-        cerr << MSG << endl;            \
-        break;                          \
-    }
-
-#define CheckDisplayErrorRelease(STAT,MSG) \
-    if ( MStatus::kSuccess != STAT ) {     \
-        MGlobal::displayError(MSG);        \
-        MThreadPool::release();            \
-        return MStatus::kFailure;          \
-    }
-
-#ifdef _DEBUG
-class Timer
-{
-public:
-    Timer(MStatus* stat = nullptr) {
-        if (stat != nullptr) {
-            restart();
-        }
-        else {
-            *stat = restart();
-        }
-    }
-
-    MStatus restart() {
-        if (!QueryPerformanceFrequency(&_freq)) {
-            return MStatus::kFailure;
-        }
-
-        if (!QueryPerformanceCounter(&_start)) {
-            return MStatus::kFailure;
-        }
-
-        return MStatus::kSuccess;
-    }
-
-    double  elapsed(MStatus* stat = nullptr) {
-        if (!QueryPerformanceCounter(&_end)) {
-            if (stat != nullptr) {
-                *stat = MStatus::kFailure;
-            }
-            return 0.0;
-        }
-
-        if (stat != nullptr) {
-            *stat = MStatus::kSuccess;
-        }
-
-        return (double)(_end.QuadPart - _start.QuadPart) / _freq.QuadPart;
-    }
-private:
-    LARGE_INTEGER _freq;
-    LARGE_INTEGER _start;
-    LARGE_INTEGER _end;
-};
-#endif // _DEBUG
-
 class checkMeshFace0Count : public MPxCommand
 {
     public:
@@ -134,6 +53,7 @@ class checkMeshFace0Count : public MPxCommand
     private:
         MSelectionList _beforeSelection;
         MSelectionList _invalid;
+        MString _profile;
 
         bool _fIsSelect;
 };
@@ -141,6 +61,7 @@ class checkMeshFace0Count : public MPxCommand
 checkMeshFace0Count::checkMeshFace0Count()
     : _beforeSelection()
     , _invalid()
+    , _profile()
     , _fIsSelect(false)
 {
 }
@@ -151,194 +72,40 @@ MSyntax checkMeshFace0Count::createSyntax() {
     MSyntax syntax;
 
     syntax.addFlag(selectArgName, selectLongArgName, MSyntax::kNoArg);
+    addMeshCheckFlags(syntax);
     return syntax;
 }
 
-typedef struct _taskDataTag
-{
-    // flags
-    MString uvSet;
-    bool    allUVSet;
-
-    // step 1
-    std::deque<MDagPath> meshArray;
-
-    // step 2
-    MSelectionList invalidList;
-
-    MStatus stat;
-
-} TaskData;
-
-// step 1
-MStatus getAllMesh(
-    TaskData& taskData // in out
-) {
-    MItDag dagIter(MItDag::kDepthFirst, MFn::kMesh, &taskData.stat);
-    CheckDisplayError(taskData.stat, "getAllMesh: could not create dagIter.");
-
-    MDagPath dagPath;
-    for (; !dagIter.isDone(); dagIter.next()) {
-        taskData.stat = dagIter.getPath(dagPath);
-        CheckDisplayError(taskData.stat, "getAllMesh: could not get dag path.");
-
-        MFnDagNode dagNode(dagPath, &taskData.stat);
-        CheckDisplayError(taskData.stat, "getAllMesh: could not get dag node.");
-
-        if (dagNode.isIntermediateObject()) {
-            continue;
-        }
-
-        taskData.meshArray.push_back(dagPath);
-    }
-    return taskData.stat;
-}
-
-typedef struct _searchFace0CountTdTag {
-    unsigned int    start, end;
-    TaskData*       taskData;
-    MSelectionList  invalidList;
-    MStatus         stat;
-} SearchMeshFace0CountTdData;
-
-// step 2
- MThreadRetVal searchMeshFace0Count(void* data) {
-    SearchMeshFace0CountTdData* td = (SearchMeshFace0CountTdData*)data;
-    TaskData* taskData = td->taskData;
-
-    for (unsigned int i = td->start; i < td->end; ++i) {
-        const MDagPath& dagPath = taskData->meshArray[i];
-
-        MFnMesh fnMesh(dagPath, &td->stat);
-        CheckErrorReturnMThreadRetVal(td->stat, "searchMeshFace0Count: could not create MFnMesh.");
-
-        const int numPolygons = fnMesh.numPolygons(&td->stat);
-        CheckErrorReturnMThreadRetVal(td->stat, "searchMeshFace0Count: could not get num polygons.");
-
-        if (numPolygons == 0) {
-            td->stat = td->invalidList.add(dagPath);
-            CheckErrorReturnMThreadRetVal(td->stat, "searchMeshFVFlipTd: could not add invalid list.");
-        }
-    }
-
-    return (MThreadRetVal)0;
-}
-
-void searchMeshFace0Count(void* data, MThreadRootTask* root) {
-
-    const auto processor_count = std::thread::hardware_concurrency() * 10;
-#ifdef _DEBUG
-    cerr << "processour_count = " << processor_count << ".\n";
-#endif // _DEBUG
-
-    TaskData* taskData = (TaskData *)data;
-
-    unsigned int size;
-    if (processor_count < taskData->meshArray.size()) {
-        size = processor_count;
-    }
-    else {
-        size = static_cast<unsigned int>(taskData->meshArray.size());
-    }
-
-    std::vector<SearchMeshFace0CountTdData> threadData(size);
-
-    float size_f = static_cast<float>(size);
-    float meshLength_f = static_cast<float>(taskData->meshArray.size());
-
-    for (unsigned int i = 0; i < size; ++i) {
-        threadData[i].start = static_cast<unsigned int>(meshLength_f / size_f * static_cast<float>(i));
-        threadData[i].end = static_cast<unsigned int>(meshLength_f / size_f * static_cast<float>(i + 1));
-        threadData[i].taskData = taskData;
-        threadData[i].stat = MStatus::kSuccess;
-
-        MThreadPool::createTask(searchMeshFace0Count, (void *)&threadData[i], root);
-    }
-
-    MThreadPool::executeAndJoin(root);
-
-    for (unsigned int i = 0; i < size; ++i) {
-        if (threadData[i].invalidList.length() > 0) {
-            taskData->stat = taskData->invalidList.merge(threadData[i].invalidList);
-            CheckErrorBreak(taskData->stat, "searchMeshFace0Count: could not merge invalid list");
-        }
-
-        taskData->stat = threadData[i].stat;
-        CheckErrorBreak(taskData->stat, "searchMeshFace0Count: thread error");
-    }
-}
-
 MStatus checkMeshFace0Count::doIt(const MArgList& args) {
     MStatus stat = MStatus::kSuccess;
 
-#ifdef _DEBUG
-    Timer timer = Timer(&stat);
-    if (MStatus::kSuccess != stat) {
-        return stat;
-    }
-#endif // _DEBUG
-
+    const auto parseStart = Profiler::now();
     MArgParser argData(syntax(), args, &stat);
     CheckDisplayError(stat, "doIt: argument syntax error.");
-    TaskData taskData;
+    MeshCheckTask taskData;
+    taskData.checks.push_back(kMeshFace0Count);
 
     if (argData.isFlagSet(selectArgName)) {
         _fIsSelect = true;
         MGlobal::getActiveSelectionList(_beforeSelection);
     }
 
-#ifdef _DEBUG
-    cerr << "parse argData = " << timer.elapsed(&stat) << "sec.\n";
-    CheckDisplayError(stat, "doIt: parse argData timer elapsed error.");
-    stat = timer.restart();
-    CheckDisplayError(stat, "doIt: parse argData timer reset error.");
-#endif // _DEBUG
+    stat = parseMeshCheckFlags(argData, taskData);
+    CheckDisplayError(stat, "doIt: could not parse mesh check flags.");
+    taskData.profiler.addStage("parse", parseStart);
 
     // ======================================================================
-    // step 1
-    stat = getAllMesh(taskData);
-    CheckDisplayError(stat, "doIt: getAllMesh.");
+    // step 1, 2
+    stat = runMeshChecks(taskData);
+    CheckDisplayError(stat, "doIt: runMeshChecks error.");
 
-#ifdef _DEBUG
-    cerr << "getAllMesh = " << timer.elapsed(&stat) << "sec.\n";
-    CheckDisplayError(stat, "doIt: getAllMesh timer elapsed error.");
-    stat = timer.restart();
-    CheckDisplayError(stat, "doIt: getAllMesh timer reset error.");
-#endif // _DEBUG
+    _invalid = taskData.invalidLists[kMeshFace0Count];
 
-    // ======================================================================
-    // check mesh size.
-    if (taskData.meshArray.size() == 0) {
-        stat = redoIt();
-        return stat;
+    if (taskData.profiler.enabled()) {
+        stat = getProfileResult(taskData, _profile);
+        CheckDisplayError(stat, "doIt: could not get profile result.");
     }
 
-    // ======================================================================
-    // Thread init.
-    stat = MThreadPool::init();
-    CheckDisplayError(stat, "doIt: could not create threadpool.");
-
-#ifdef _DEBUG
-    cerr << "MThreadPool = " << timer.elapsed(&stat) << "sec.\n";
-    CheckDisplayError(stat, "doIt: MThreadPool timer elapsed error.");
-    stat = timer.restart();
-    CheckDisplayError(stat, "doIt: MThreadPool timer reset error.");
-#endif // _DEBUG
-
-    // ======================================================================
-    // step 2
-    MThreadPool::newParallelRegion(searchMeshFace0Count, (void *)&taskData);
-    CheckDisplayErrorRelease(taskData.stat, "doIt: countMeshes error.");
-
-#ifdef _DEBUG
-    cerr << "searchMeshFace0Count = " << timer.elapsed(&stat) << "sec.\n";
-    CheckDisplayError(stat, "doIt: searchMeshFace0Count timer elapsed error.");
-    stat = timer.restart();
-    CheckDisplayError(stat, "doIt: searchMeshFace0Count timer reset error.");
-#endif // _DEBUG
-
-    _invalid = taskData.invalidList;
-
     stat = redoIt();
 
     return stat;
@@ -349,6 +116,10 @@ MStatus checkMeshFace0Count::redoIt() {
         MStatus stat = MGlobal::setActiveSelectionList(_invalid);
         return stat;
     }
+    if (_profile.length() > 0) {
+        setResult(_profile);
+        return MStatus::kSuccess;
+    }
     MStringArray results;
     MStatus stat = _invalid.getSelectionStrings(results);
     CheckDisplayError(stat, "redoIt: invalid.getSelectionStrings is failed.");
@@ -384,6 +155,7 @@ MStatus uninitializePlugin(MObject obj)
 {
     MFnPlugin plugin( obj );
     plugin.deregisterCommand("checkMeshFace0Count");
+    meshCheckCache().clear();
     return MS::kSuccess;
 }
 
@@ -0,0 +1,446 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+// modelcheck
+//
+// Headless front end of the mesh check kernels. Loads OBJ files into
+// MeshData and runs the same kernels as the Maya plugins, without Maya.
+//
+//   modelcheck [-check name]... [-uvSet name] [-allUVSet] [-threads n] [-splitFaces n]
+//              [-tolerance d] [-crossMesh] [-groups] [-udim] [-uvComponents] [-workerStats]
+//              [-profile [-profileMeshes n]] file.obj...
+//
+// Prints one "check<TAB>item" line per result to stdout. OBJ points are in
+// world space, so -crossMesh compares them as they are. -groups adds one
+// "checkMeshDoubleFaceGroup<TAB>mesh<TAB>face face..." line per set of
+// faces that double each other. -udim adds, with the uvTilingOver check, one
+// "checkMeshUDIM<TAB>mesh<TAB>uvSet<TAB>udim udim..." line per uv set,
+// "outside" at the end when uvs are off the UDIM grid, and one
+// "checkMeshUDIMShell<TAB>mesh<TAB>uvSet<TAB>shell<TAB>minU maxU minV maxV"
+// tile range per shell. -uvComponents reports uvTilingOver as the
+// "mesh.map[...]" uvs of the shells over tiles. Timings, worker stats and
+// the -profile JSON go to stderr.
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/crossMesh.h"
+#include "../common/meshKernels.h"
+#include "../common/objLoader.h"
+#include "../common/profiler.h"
+#include "../common/scheduler.h"
+
+namespace
+{
+    struct Options
+    {
+        Options() : uvSet("map1"), allUVSet(false), threads(0), splitFaces(kDefaultSplitFaces), crossMesh(false), workerStats(false), profile(false), profileMeshes(10) {}
+
+        std::vector<MeshCheckKind> checks;
+        std::string uvSet;
+        bool allUVSet;
+        unsigned int threads;
+        unsigned int splitFaces;
+        MeshKernelOptions kernelOptions;
+        bool crossMesh;
+        bool workerStats;
+        bool profile;
+        unsigned int profileMeshes;
+        std::vector<std::string> files;
+    };
+
+    void usage() {
+        fprintf(stderr,
+            "usage: modelcheck [-check name]... [-uvSet name] [-allUVSet] [-threads n] [-splitFaces n]\n"
+            "                  [-tolerance d] [-crossMesh] [-groups] [-udim] [-uvComponents] [-workerStats]\n"
+            "                  [-profile [-profileMeshes n]] file.obj...\n"
+            "checks:");
+        for (int k = 0; k < kMeshCheckCount; ++k) {
+            fprintf(stderr, " %s", meshCheckShortNames[k]);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    bool isFlag(const char* arg, const char* shortName, const char* longName) {
+        return std::strcmp(arg, shortName) == 0 || std::strcmp(arg, longName) == 0;
+    }
+
+    bool parseArgs(int argc, char** argv, Options& options) {
+        bool enabled[kMeshCheckCount] = {};
+        bool anyCheck = false;
+        for (int i = 1; i < argc; ++i) {
+            const char* arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (isFlag(arg, "-c", "-check") && hasValue) {
+                MeshCheckKind kind;
+                if (!findMeshCheck(argv[++i], kind)) {
+                    fprintf(stderr, "modelcheck: unknown check %s.\n", argv[i]);
+                    return false;
+                }
+                enabled[kind] = true;
+                anyCheck = true;
+            }
+            else if (isFlag(arg, "-uvs", "-uvSet") && hasValue) {
+                options.uvSet = argv[++i];
+            }
+            else if (isFlag(arg, "-all", "-allUVSet")) {
+                options.allUVSet = true;
+            }
+            else if (isFlag(arg, "-t", "-threads") && hasValue) {
+                options.threads = static_cast<unsigned int>(std::atoi(argv[++i]));
+            }
+            else if (isFlag(arg, "-sf", "-splitFaces") && hasValue) {
+                options.splitFaces = static_cast<unsigned int>(std::atoi(argv[++i]));
+            }
+            else if (isFlag(arg, "-tol", "-tolerance") && hasValue) {
+                options.kernelOptions.tolerance = std::atof(argv[++i]);
+                if (!isValidTolerance(options.kernelOptions.tolerance)) {
+                    fprintf(stderr, "modelcheck: tolerance must be 0, or between 1e-12 and the largest double.\n");
+                    return false;
+                }
+            }
+            else if (isFlag(arg, "-gr", "-groups")) {
+                options.kernelOptions.doubleFaceGroups = true;
+            }
+            else if (isFlag(arg, "-ud", "-udim")) {
+                options.kernelOptions.udimReport = true;
+            }
+            else if (isFlag(arg, "-uvc", "-uvComponents")) {
+                options.kernelOptions.tilingOverUVs = true;
+            }
+            else if (isFlag(arg, "-cm", "-crossMesh")) {
+                options.crossMesh = true;
+            }
+            else if (isFlag(arg, "-ws", "-workerStats")) {
+                options.workerStats = true;
+            }
+            else if (isFlag(arg, "-p", "-profile")) {
+                options.profile = true;
+            }
+            else if (isFlag(arg, "-pm", "-profileMeshes") && hasValue) {
+                options.profileMeshes = static_cast<unsigned int>(std::atoi(argv[++i]));
+            }
+            else if (arg[0] == '-') {
+                fprintf(stderr, "modelcheck: unknown flag %s.\n", arg);
+                return false;
+            }
+            else {
+                options.files.push_back(arg);
+            }
+        }
+
+        for (int k = 0; k < kMeshCheckCount; ++k) {
+            if (enabled[k] || !anyCheck) {
+                options.checks.push_back(static_cast<MeshCheckKind>(k));
+            }
+        }
+        return !options.files.empty();
+    }
+
+    // Runs body(i) for i in [0, n) on numThreads threads.
+    struct ThreadParallelFor
+    {
+        unsigned int numThreads;
+
+        template<typename Body>
+        void operator()(const unsigned int n, Body body) const {
+            std::atomic<unsigned int> next(0);
+            auto worker = [&]() {
+                for (unsigned int i = next++; i < n; i = next++) {
+                    body(i);
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (unsigned int t = 1; t < numThreads && t < n; ++t) {
+                threads.emplace_back(worker);
+            }
+            worker();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+    };
+
+    // Print faces the way Maya's getSelectionStrings groups them: f[0:3].
+    // ids as mesh.component[i] and mesh.component[i:j] ranges.
+    void printComponents(const char* checkName, const std::string& meshName, const char* component, const std::vector<int>& ids) {
+        size_t i = 0;
+        while (i < ids.size()) {
+            size_t j = i;
+            while (j + 1 < ids.size() && ids[j + 1] == ids[j] + 1) {
+                ++j;
+            }
+            if (i == j) {
+                printf("%s\t%s.%s[%d]\n", checkName, meshName.c_str(), component, ids[i]);
+            }
+            else {
+                printf("%s\t%s.%s[%d:%d]\n", checkName, meshName.c_str(), component, ids[i], ids[j]);
+            }
+            i = j + 1;
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    Profiler profiler;
+    if (options.profile) {
+        profiler.enable(options.profileMeshes);
+    }
+
+    auto start = Profiler::now();
+
+    std::vector<MeshData> meshes;
+    std::string error;
+    for (const auto& file : options.files) {
+        if (!loadObj(file, file + ":", meshes, error)) {
+            fprintf(stderr, "modelcheck: %s\n", error.c_str());
+            return 1;
+        }
+    }
+    profiler.addStage("load", start);
+    const double loadSec = profiler.stages().back().sec;
+
+    start = Profiler::now();
+    bool hasUVCheck = false;
+    for (const auto& kind : options.checks) {
+        hasUVCheck |= isUVCheck(kind);
+    }
+
+    std::vector<MeshView> views(meshes.size());
+    std::vector<std::vector<unsigned int>> uvSetIndices(meshes.size());
+    size_t numFaces = 0;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        views[i] = meshes[i].view();
+        numFaces += views[i].numFaces;
+
+        if (!hasUVCheck) {
+            continue;
+        }
+        if (options.allUVSet) {
+            for (unsigned int s = 0; s < meshes[i].uvSets.size(); ++s) {
+                uvSetIndices[i].push_back(s);
+            }
+            continue;
+        }
+        const int s = meshes[i].findUVSet(options.uvSet);
+        if (s == -1) {
+            fprintf(stderr, "%s has't the %s uvSet. skip.\n", meshes[i].name.c_str(), options.uvSet.c_str());
+            continue;
+        }
+        uvSetIndices[i].push_back(static_cast<unsigned int>(s));
+    }
+
+    unsigned int numThreads = options.threads;
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    bool hasSplitCheck = false;
+    for (const auto& kind : options.checks) {
+        hasSplitCheck |= isSplitMeshCheck(kind);
+    }
+
+    // large meshes are split into face ranges after the scheduled ones.
+    std::vector<unsigned int> scheduled;
+    std::vector<unsigned int> splitMeshes;
+    std::vector<double> costs;
+    for (unsigned int i = 0; i < meshes.size(); ++i) {
+        if (hasSplitCheck && options.splitFaces > 0 && views[i].numFaces >= options.splitFaces) {
+            splitMeshes.push_back(i);
+            continue;
+        }
+        scheduled.push_back(i);
+        costs.push_back(estimateMeshCost(views[i].numFaces, views[i].numFaceVertices,
+            static_cast<unsigned int>(uvSetIndices[i].size())));
+    }
+
+    WorkScheduler scheduler;
+    scheduler.reset(costs, numThreads);
+    profiler.resetItems(meshes.size());
+    profiler.addStage("estimate", start);
+
+    const auto checkStart = Profiler::now();
+
+    const bool crossMesh = options.crossMesh
+        && std::find(options.checks.begin(), options.checks.end(), kMeshDoubleFace) != options.checks.end();
+    CrossMeshTable crossMeshTable;
+    if (crossMesh) {
+        size_t numFaces = 0;
+        for (const auto& view : views) {
+            numFaces += view.numFaces;
+        }
+        crossMeshTable.reserve(views.size(), numFaces);
+    }
+    std::vector<std::vector<CrossMeshHit>> crossHits(numThreads + 1);
+
+    std::vector<MeshCheckResult> results(meshes.size());
+    auto worker = [&](unsigned int w) {
+        MeshKernelScratch scratch;
+        CrossMeshScratch crossScratch;
+        scheduler.work(w, [&](unsigned int, unsigned int item) {
+            const unsigned int i = scheduled[item];
+            const auto meshStart = Profiler::now();
+            runMeshKernels(views[i], options.checks, uvSetIndices[i], options.kernelOptions, scratch, results[i]);
+            if (crossMesh) {
+                crossMeshTable.search(views[i], nullptr, i, crossScratch, crossHits[w]);
+            }
+            profiler.setItemTime(i, Profiler::seconds(meshStart));
+            return true;
+        });
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < numThreads; ++t) {
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    scheduler.setWallTime(Profiler::seconds(checkStart));
+    profiler.addStage("parallelRegion", checkStart);
+
+    start = Profiler::now();
+    if (!splitMeshes.empty()) {
+        ThreadParallelFor parallelFor;
+        parallelFor.numThreads = numThreads;
+
+        MeshKernelScratch scratch;
+        MeshSplitScratch split;
+        CrossMeshScratch crossScratch;
+        for (const auto& i : splitMeshes) {
+            const auto meshStart = Profiler::now();
+            runMeshKernelsSplit(views[i], options.checks, uvSetIndices[i], numThreads * 4,
+                options.kernelOptions, parallelFor, scratch, split, results[i]);
+            if (crossMesh) {
+                crossMeshTable.search(views[i], nullptr, i, crossScratch, crossHits[numThreads]);
+            }
+            profiler.setItemTime(i, Profiler::seconds(meshStart));
+        }
+    }
+    profiler.addStage("splitMeshes", start);
+    const double checkSec = Profiler::seconds(checkStart);
+
+    start = Profiler::now();
+
+    // cross mesh hits join the double faces of their mesh, a duplicate
+    // shape is reported whole.
+    std::vector<unsigned char> wholeMeshes(meshes.size(), 0);
+    for (const auto& hits : crossHits) {
+        for (const auto& hit : hits) {
+            results[hit.mesh].invalid[kMeshDoubleFace] = true;
+            if (hit.face < 0) {
+                wholeMeshes[hit.mesh] = 1;
+                continue;
+            }
+            results[hit.mesh].faces[kMeshDoubleFace].push_back(hit.face);
+        }
+    }
+    if (crossMesh) {
+        for (auto& result : results) {
+            sortUnique(result.faces[kMeshDoubleFace]);
+        }
+    }
+
+    for (const auto& kind : options.checks) {
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            if (!results[i].invalid[kind]) {
+                continue;
+            }
+            if (isFaceCheck(kind) && !(kind == kMeshDoubleFace && wholeMeshes[i])) {
+                printComponents(meshCheckName(kind), meshes[i].name, "f", results[i].faces[kind]);
+            }
+            else if (kind == kMeshUVTilingOver && !results[i].faces[kind].empty()) {
+                printComponents(meshCheckName(kind), meshes[i].name, "map", results[i].faces[kind]);
+            }
+            else {
+                printf("%s\t%s\n", meshCheckName(kind), meshes[i].name.c_str());
+            }
+        }
+    }
+
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const std::vector<int>& groups = results[i].doubleFaceGroups;
+        size_t g = 0;
+        while (g < groups.size()) {
+            const int count = groups[g];
+            printf("checkMeshDoubleFaceGroup\t%s\t", meshes[i].name.c_str());
+            for (int f = 0; f < count; ++f) {
+                printf(f == 0 ? "%d" : " %d", groups[g + 1 + f]);
+            }
+            printf("\n");
+            g += 1 + count;
+        }
+    }
+
+    std::vector<int> udims;
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        for (const auto& report : results[i].udimReports) {
+            const char* uvSetName = meshes[i].uvSets[report.uvSet].name.c_str();
+            getUDIMs(report, udims);
+            printf("checkMeshUDIM\t%s\t%s\t", meshes[i].name.c_str(), uvSetName);
+            for (size_t u = 0; u < udims.size(); ++u) {
+                printf(u == 0 ? "%d" : " %d", udims[u]);
+            }
+            printf(report.outside ? (udims.empty() ? "outside\n" : " outside\n") : "\n");
+
+            const std::vector<int>& tiles = report.shellTiles;
+            for (size_t shell = 0; shell * 4 < tiles.size(); ++shell) {
+                printf("checkMeshUDIMShell\t%s\t%s\t%zu\t%d %d %d %d\n", meshes[i].name.c_str(), uvSetName, shell,
+                    tiles[shell * 4 + 0], tiles[shell * 4 + 1], tiles[shell * 4 + 2], tiles[shell * 4 + 3]);
+            }
+        }
+    }
+
+    profiler.addStage("results", start);
+
+    fprintf(stderr, "modelcheck: %zu meshes (%zu split), %zu faces, load %.6f sec, check %.6f sec, %u threads.\n",
+        meshes.size(), splitMeshes.size(), numFaces, loadSec, checkSec, numThreads);
+    if (options.workerStats) {
+        printWorkerStats(scheduler, [](const char* line) {
+            fprintf(stderr, "%s\n", line);
+        });
+    }
+    if (options.profile) {
+        std::string json;
+        writeProfileJson(json, profiler, scheduler, [&](unsigned int i) {
+            return meshes[i].name;
+        }, std::string());
+        fprintf(stderr, "%s\n", json.c_str());
+    }
+    return 0;
+}
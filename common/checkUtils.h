@@ -0,0 +1,63 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+#include <maya/MGlobal.h>
+#include <maya/MThreadPool.h>
+
+#define CheckDisplayErrorOnly(STAT,MSG)\
+    if ( MStatus::kSuccess != STAT ) { \
+        MGlobal::displayError(MSG);    \
+    }
+
+#define CheckDisplayError(STAT,MSG)    \
+    if ( MStatus::kSuccess != STAT ) { \
+        MGlobal::displayError(MSG);    \
+        return MStatus::kFailure;      \
+    }
+
+#define CheckErrorReturnMThreadRetVal(STAT,MSG) \
+    if ( MStatus::kSuccess != STAT ) {          \
+        cerr << MSG << endl;                    \
+        return (MThreadRetVal)0;                \
+    }
+
+#define CheckErrorReturn(STAT,MSG)      \
+    if ( MStatus::kSuccess != STAT ) {  \
+        cerr << MSG << endl;            \
+        return STAT;                    \
+    }
+
+#define CheckErrorBreak(STAT,MSG)       \
+    if ( MStatus::kSuccess != STAT ) {  \
+        cerr << MSG << endl;            \
+        break;                          \
+    }
+
+#define CheckDisplayErrorRelease(STAT,MSG) \
+    if ( MStatus::kSuccess != STAT ) {     \
+        MGlobal::displayError(MSG);        \
+        MThreadPool::release();            \
+        return MStatus::kFailure;          \
+    }
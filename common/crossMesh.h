@@ -0,0 +1,424 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Double faces across meshes (-crossMesh).
+//
+// Every mesh is hashed in world space into a table shared by all workers,
+// once per instance, so instances are compared with each other too.
+// A mesh first adds its shape fingerprint: a mesh with the same vertices
+// and faces as an earlier one is a duplicate shape, both meshes are
+// reported whole and its faces are not looked at. Otherwise the face
+// signature hashes of the mesh are added, a face whose hash is owned by
+// another mesh is reported together with the face of that mesh.
+//
+// The table is split into shards, each an open addressing table behind its
+// own mutex, sized up front from the face count of the scene. A mesh
+// groups its faces by shard first and locks every shard once. The table
+// keeps no points: an instance keeps the mesh the caller bound and its
+// world matrix, and a hash hit is only reported once the points, or the
+// face vertex positions, moved to world space compare equal. A hash
+// collision adds the mesh or face next to the one it collided with.
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "meshKernels.h"
+
+// A face found by the cross mesh search, face -1 for a whole mesh.
+struct CrossMeshHit
+{
+    unsigned int mesh;
+    int face;
+};
+
+struct CrossMeshScratch
+{
+    struct Entry
+    {
+        uint64_t hash;
+        int face;
+        unsigned int offset;
+    };
+
+    std::vector<float> worldPoints;
+    // face hashes per shard.
+    std::vector<std::vector<Entry>> batches;
+    std::vector<FaceVertexKey> faceKeys[2];
+};
+
+// Copy of the faces of a mesh, for callers whose bound faces do not live
+// as long as the CrossMeshTable.
+struct CrossMeshFaces
+{
+    std::vector<int> faceCounts;
+    std::vector<int> faceConnects;
+
+    // mesh, with its faces in the copy.
+    MeshView keep(const MeshView& mesh) {
+        faceCounts.assign(mesh.faceCounts, mesh.faceCounts + mesh.numFaces);
+        faceConnects.assign(mesh.faceConnects, mesh.faceConnects + mesh.numFaceVertices);
+
+        MeshView kept;
+        kept.points = mesh.points;
+        kept.numVertices = mesh.numVertices;
+        kept.faceCounts = faceCounts.data();
+        kept.numFaces = mesh.numFaces;
+        kept.faceConnects = faceConnects.data();
+        kept.numFaceVertices = mesh.numFaceVertices;
+        return kept;
+    }
+};
+
+// world = point times matrix, a row major 4x4 matrix that multiplies row
+// vectors (MMatrix::get).
+inline void transformPoint(const float* point, const double* matrix, float* world) {
+    const double x = point[0];
+    const double y = point[1];
+    const double z = point[2];
+    for (int c = 0; c < 3; ++c) {
+        world[c] = static_cast<float>(
+            x * matrix[0 * 4 + c] + y * matrix[1 * 4 + c] + z * matrix[2 * 4 + c] + matrix[3 * 4 + c]);
+    }
+}
+
+// Points of mesh times matrix. Returns mesh with points replaced.
+inline MeshView transformMeshPoints(
+    const MeshView& mesh,
+    const double* matrix,
+    std::vector<float>& worldPoints
+) {
+    worldPoints.resize(mesh.numVertices * 3);
+    for (unsigned int i = 0; i < mesh.numVertices; ++i) {
+        transformPoint(mesh.points + i * 3, matrix, worldPoints.data() + i * 3);
+    }
+
+    MeshView world;
+    world.points = worldPoints.data();
+    world.numVertices = mesh.numVertices;
+    world.faceCounts = mesh.faceCounts;
+    world.numFaces = mesh.numFaces;
+    world.faceConnects = mesh.faceConnects;
+    world.numFaceVertices = mesh.numFaceVertices;
+    return world;
+}
+
+// An instance of a mesh searched by CrossMeshTable: the mesh as the caller
+// bound it and the world matrix of the instance, none for a mesh already in
+// world space. Never changes once its hashes are in the table.
+struct CrossMeshOwner
+{
+    unsigned int mesh;
+    MeshView view;
+    bool hasMatrix;
+    double matrix[16];
+
+    CrossMeshOwner(const MeshView& mesh, const double* worldMatrix, const unsigned int meshIndex)
+        : mesh(meshIndex)
+        , hasMatrix(worldMatrix != nullptr)
+    {
+        view.points = mesh.points;
+        view.numVertices = mesh.numVertices;
+        view.faceCounts = mesh.faceCounts;
+        view.numFaces = mesh.numFaces;
+        view.faceConnects = mesh.faceConnects;
+        view.numFaceVertices = mesh.numFaceVertices;
+        if (hasMatrix) {
+            std::copy(worldMatrix, worldMatrix + 16, matrix);
+        }
+    }
+
+    // Key of vertexId in world space, the same bits transformMeshPoints
+    // gives.
+    FaceVertexKey worldKey(const int vertexId) const {
+        if (!hasMatrix) {
+            return faceVertexKey(view, vertexId);
+        }
+        float world[3];
+        transformPoint(view.points + vertexId * 3, matrix, world);
+        FaceVertexKey key;
+        key.x = floatKey(world[0]);
+        key.y = floatKey(world[1]);
+        key.z = floatKey(world[2]);
+        return key;
+    }
+};
+
+// Whether world, a mesh in world space, and instance b have the same
+// vertex positions and the same faces, in order. What meshFingerprint
+// hashes.
+inline bool sameMeshShape(const MeshView& world, const CrossMeshOwner& b) {
+    const MeshView& view = b.view;
+    if (world.numVertices != view.numVertices || world.numFaces != view.numFaces || world.numFaceVertices != view.numFaceVertices) {
+        return false;
+    }
+    for (unsigned int i = 0; i < world.numVertices; ++i) {
+        if (!(faceVertexKey(world, static_cast<int>(i)) == b.worldKey(static_cast<int>(i)))) {
+            return false;
+        }
+    }
+    return std::equal(world.faceCounts, world.faceCounts + world.numFaces, view.faceCounts)
+        && std::equal(world.faceConnects, world.faceConnects + world.numFaceVertices, view.faceConnects);
+}
+
+// Whether the face at connectA of world, a mesh in world space, and face
+// faceB of instance b, at offsetB in its faceConnects, have the same sorted
+// vertex positions. What faceSignatureHash hashes.
+inline bool sameFacePositions(
+    const MeshView& world,
+    const int* connectA,
+    const int count,
+    const CrossMeshOwner& b,
+    const int faceB,
+    const unsigned int offsetB,
+    CrossMeshScratch& scratch
+) {
+    if (b.view.faceCounts[faceB] != count) {
+        return false;
+    }
+
+    std::vector<FaceVertexKey>& keysA = scratch.faceKeys[0];
+    std::vector<FaceVertexKey>& keysB = scratch.faceKeys[1];
+    keysA.resize(count);
+    keysB.resize(count);
+    const int* connectB = b.view.faceConnects + offsetB;
+    for (int v = 0; v < count; ++v) {
+        keysA[v] = faceVertexKey(world, connectA[v]);
+        keysB[v] = b.worldKey(connectB[v]);
+    }
+    std::sort(keysA.begin(), keysA.end());
+    std::sort(keysB.begin(), keysB.end());
+    return keysA == keysB;
+}
+
+// Hash of the vertex positions and the faces of mesh, in order.
+inline uint64_t meshFingerprint(const MeshView& mesh) {
+    uint64_t hash = mixHash(((uint64_t)mesh.numVertices << 32) | mesh.numFaces);
+    for (unsigned int i = 0; i < mesh.numVertices * 3; ++i) {
+        hash = mixHash(hash ^ floatKey(mesh.points[i]));
+    }
+    for (unsigned int f = 0; f < mesh.numFaces; ++f) {
+        hash = mixHash(hash ^ (uint32_t)mesh.faceCounts[f]);
+    }
+    for (unsigned int i = 0; i < mesh.numFaceVertices; ++i) {
+        hash = mixHash(hash ^ (uint32_t)mesh.faceConnects[i]);
+    }
+    return hash;
+}
+
+class CrossMeshTable
+{
+public:
+    explicit CrossMeshTable(const unsigned int numShards = 64)
+        : _numShards(numShards)
+        , _shards(new Shard[numShards])
+    {
+        reserve(0, 0);
+    }
+
+    // Empty the table and size it for numInstances instances with
+    // numFaces faces in all, the faces of every instance counted. A shard
+    // that fills up anyway grows under its lock. Call before the first
+    // search, from one thread.
+    void reserve(const size_t numInstances, const size_t numFaces) {
+        for (unsigned int s = 0; s < _numShards; ++s) {
+            resetSlots(_shards[s].faces, numFaces / _numShards + 1);
+            resetSlots(_shards[s].shapes, numInstances / _numShards + 1);
+            _shards[s].numFaces = 0;
+            _shards[s].numShapes = 0;
+        }
+        _owners.clear();
+    }
+
+    // Search an instance of mesh against the instances added so far and
+    // add it. matrix is the world matrix of the instance (see
+    // transformPoint), null when mesh is in world space already. The table
+    // reads mesh again when other meshes hit it, so its points and faces
+    // must live as long as the table. Meshes without faces are skipped.
+    void search(
+        const MeshView& mesh,
+        const double* matrix,
+        const unsigned int meshIndex,
+        CrossMeshScratch& scratch,
+        std::vector<CrossMeshHit>& hits
+    ) {
+        if (mesh.numFaces == 0) {
+            return;
+        }
+
+        const CrossMeshOwner* owner = keep(mesh, matrix, meshIndex);
+        const MeshView world = matrix != nullptr ? transformMeshPoints(mesh, matrix, scratch.worldPoints) : owner->view;
+        const uint64_t fingerprint = meshFingerprint(world);
+        Shard& shapeShard = _shards[hashPartition(static_cast<size_t>(fingerprint), _numShards)];
+        {
+            std::lock_guard<std::mutex> lock(shapeShard.mutex);
+            ShapeSlot* slot = findSlot(shapeShard.shapes, fingerprint, [&](const ShapeSlot& other) {
+                return sameMeshShape(world, *other.owner);
+            });
+            if (slot->owner != nullptr) {
+                hits.push_back({ meshIndex, -1 });
+                hits.push_back({ slot->owner->mesh, -1 });
+                return;
+            }
+            slot->hash = fingerprint;
+            slot->owner = owner;
+            if (++shapeShard.numShapes * 4 > shapeShard.shapes.size() * 3) {
+                growSlots(shapeShard.shapes);
+            }
+        }
+
+        scratch.batches.resize(_numShards);
+        for (auto& batch : scratch.batches) {
+            batch.clear();
+        }
+        unsigned int offset = 0;
+        for (unsigned int faceId = 0; faceId < mesh.numFaces; ++faceId) {
+            CrossMeshScratch::Entry entry;
+            entry.hash = faceSignatureHash(world, world.faceConnects + offset, world.faceCounts[faceId]);
+            entry.face = static_cast<int>(faceId);
+            entry.offset = offset;
+            scratch.batches[hashPartition(static_cast<size_t>(entry.hash), _numShards)].push_back(entry);
+            offset += world.faceCounts[faceId];
+        }
+
+        for (unsigned int s = 0; s < _numShards; ++s) {
+            const auto& batch = scratch.batches[s];
+            if (batch.empty()) {
+                continue;
+            }
+
+            Shard& shard = _shards[s];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& entry : batch) {
+                const int* connect = world.faceConnects + entry.offset;
+                const int count = world.faceCounts[entry.face];
+                FaceSlot* slot = findSlot(shard.faces, entry.hash, [&](const FaceSlot& other) {
+                    return sameFacePositions(world, connect, count, *other.owner, other.face, other.offset, scratch);
+                });
+                if (slot->owner != nullptr) {
+                    if (slot->owner != owner) {
+                        // a double face within the instance is not a hit,
+                        // one between instances of the mesh is.
+                        hits.push_back({ meshIndex, entry.face });
+                        hits.push_back({ slot->owner->mesh, slot->face });
+                    }
+                    continue;
+                }
+                slot->hash = entry.hash;
+                slot->owner = owner;
+                slot->face = entry.face;
+                slot->offset = entry.offset;
+                if (++shard.numFaces * 4 > shard.faces.size() * 3) {
+                    growSlots(shard.faces);
+                }
+            }
+        }
+    }
+
+private:
+    struct FaceSlot
+    {
+        uint64_t hash;
+        const CrossMeshOwner* owner; // null: empty
+        int face;
+        unsigned int offset;
+    };
+
+    struct ShapeSlot
+    {
+        uint64_t hash;
+        const CrossMeshOwner* owner; // null: empty
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::vector<FaceSlot> faces;
+        std::vector<ShapeSlot> shapes;
+        size_t numFaces;
+        size_t numShapes;
+    };
+
+    template <typename Slot>
+    static void resetSlots(std::vector<Slot>& slots, const size_t count) {
+        size_t capacity = 16;
+        while (capacity < count * 2) {
+            capacity <<= 1;
+        }
+        slots.assign(capacity, Slot());
+    }
+
+    // Slot of the entry with hash that same accepts, or else the empty
+    // slot it goes to. Several entries share a hash on a collision only.
+    template <typename Slot, typename Same>
+    static Slot* findSlot(std::vector<Slot>& slots, const uint64_t hash, Same same) {
+        const size_t mask = slots.size() - 1;
+        for (size_t i = static_cast<size_t>(hash) & mask;; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (slot.owner == nullptr || (slot.hash == hash && same(slot))) {
+                return &slot;
+            }
+        }
+    }
+
+    // Double the capacity, keeping the entries.
+    template <typename Slot>
+    static void growSlots(std::vector<Slot>& slots) {
+        std::vector<Slot> old(slots.size() * 2, Slot());
+        old.swap(slots);
+        const size_t mask = slots.size() - 1;
+        for (const auto& slot : old) {
+            if (slot.owner == nullptr) {
+                continue;
+            }
+            size_t i = static_cast<size_t>(slot.hash) & mask;
+            while (slots[i].owner != nullptr) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
+        }
+    }
+
+    // An instance that lives as long as the table. Other workers read it
+    // once they find it in a shard, after the shard lock.
+    const CrossMeshOwner* keep(
+        const MeshView& mesh,
+        const double* matrix,
+        const unsigned int meshIndex
+    ) {
+        std::lock_guard<std::mutex> lock(_ownersMutex);
+        _owners.emplace_back(mesh, matrix, meshIndex);
+        return &_owners.back();
+    }
+
+    unsigned int _numShards;
+    std::unique_ptr<Shard[]> _shards;
+    std::mutex _ownersMutex;
+    // a deque does not move its elements when it grows.
+    std::deque<CrossMeshOwner> _owners;
+};
@@ -0,0 +1,486 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Curve check kernels on CurveView. Used by checkCurve* plugins and by the
+// benchmark.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "curveView.h"
+#include "toleranceGrid.h"
+
+// Bits of a cv coordinate, -0 is 0.
+inline uint64_t curveCoordinateKey(const double value) {
+    const double zero = value == 0.0 ? 0.0 : value;
+    uint64_t bits;
+    std::memcpy(&bits, &zero, sizeof(bits));
+    return bits;
+}
+
+inline uint64_t curveMixHash(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+inline uint64_t curvePositionHash(const double* cv) {
+    uint64_t hash = curveMixHash(curveCoordinateKey(cv[0]));
+    hash = curveMixHash(hash ^ curveCoordinateKey(cv[1]));
+    return curveMixHash(hash ^ curveCoordinateKey(cv[2]));
+}
+
+// Partition of a position hash, from the high bits. The tables bucket
+// with the low bits.
+inline unsigned int curvePartition(const uint64_t hash, const unsigned int count) {
+    return static_cast<unsigned int>(((hash >> 32) * count) >> 32);
+}
+
+// Open addressing table of cv positions. A slot keeps the first cv seen
+// at a position.
+struct CurvePositionTable
+{
+    struct Slot
+    {
+        uint64_t     hash;
+        int          curve; // -1: empty
+        unsigned int cv;
+    };
+
+    std::vector<Slot> slots;
+    size_t mask = 0;
+
+    void reset(const size_t numCVs) {
+        size_t capacity = 16;
+        while (capacity < numCVs * 2) {
+            capacity <<= 1;
+        }
+        Slot empty;
+        empty.hash = 0;
+        empty.curve = -1;
+        empty.cv = 0;
+        slots.assign(capacity, empty);
+        mask = capacity - 1;
+    }
+};
+
+// Cell of a tolerance grid. A slot maps a cell to the last cv in it, the
+// earlier cvs of the cell are chained through CurveMatchScratch::cellNext.
+struct CurveCellTable
+{
+    struct Slot
+    {
+        int64_t x, y, z;
+        int     head; // -1: empty
+    };
+
+    std::vector<Slot> slots;
+    size_t mask = 0;
+
+    void reset(const size_t numCVs) {
+        size_t capacity = 16;
+        while (capacity < numCVs * 2) {
+            capacity <<= 1;
+        }
+        Slot empty;
+        empty.x = empty.y = empty.z = 0;
+        empty.head = -1;
+        slots.assign(capacity, empty);
+        mask = capacity - 1;
+    }
+
+    // Slot of cell (x, y, z), or of the empty slot where it would go.
+    Slot& find(const int64_t x, const int64_t y, const int64_t z) {
+        uint64_t hash = curveMixHash((uint64_t)x);
+        hash = curveMixHash(hash ^ (uint64_t)y);
+        hash = curveMixHash(hash ^ (uint64_t)z);
+        for (size_t i = static_cast<size_t>(hash) & mask;; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (slot.head < 0 || (slot.x == x && slot.y == y && slot.z == z)) {
+                return slot;
+            }
+        }
+    }
+};
+
+// Settings of searchCurveSamePositionSplit.
+struct CurveMatchOptions
+{
+    CurveMatchOptions() : tolerance(0.0), matches(false) {}
+
+    // 0 compares exact positions, otherwise cvs within tolerance match.
+    double tolerance;
+    // also report the matching cvs.
+    bool matches;
+};
+
+// Cv B matches the earlier cv A. A and B are on the same curve for a self
+// duplicate. cvA and cvB are -1 when curve B is a copy of curve A: the
+// same cvs in the same order.
+struct CurveMatch
+{
+    unsigned int curveA;
+    int          cvA;
+    unsigned int curveB;
+    int          cvB;
+
+    bool operator<(const CurveMatch& rhs) const {
+        if (curveA != rhs.curveA) return curveA < rhs.curveA;
+        if (cvA != rhs.cvA) return cvA < rhs.cvA;
+        if (curveB != rhs.curveB) return curveB < rhs.curveB;
+        return cvB < rhs.cvB;
+    }
+};
+
+struct CurveMatchScratch
+{
+    struct Entry
+    {
+        unsigned int curve;
+        unsigned int cv;
+    };
+
+    // range r is curves [begins[r], begins[r + 1]).
+    std::vector<unsigned int> begins;
+    // whole curve copies.
+    std::vector<uint64_t> fingerprints;
+    std::vector<unsigned char> copies;
+    std::vector<unsigned int> copyFound;
+    std::vector<CurveMatch> copyMatches;
+    // [range][partition] cvs of the range that hash to the partition.
+    std::vector<std::vector<std::vector<Entry>>> ranges;
+    std::vector<CurvePositionTable> tables;
+    // curves found per partition, with repeats.
+    std::vector<std::vector<unsigned int>> partitionFound;
+    std::vector<std::vector<CurveMatch>> partitionMatches;
+    // tolerance, the cvs in curve order.
+    CurveCellTable cellTable;
+    std::vector<Entry> cells;
+    std::vector<int> cellNext;
+    // one bit per curve, set when the curve is found.
+    std::vector<uint64_t> flagged;
+};
+
+// Hash of the cv positions of curve, in order.
+inline uint64_t curveFingerprint(const CurveView& curve) {
+    uint64_t hash = curveMixHash(curve.numCVs);
+    for (unsigned int i = 0; i < curve.numCVs * 3; ++i) {
+        hash = curveMixHash(hash ^ curveCoordinateKey(curve.cvs[i]));
+    }
+    return hash;
+}
+
+inline bool sameCurveCVs(const CurveView& a, const CurveView& b) {
+    if (a.numCVs != b.numCVs) {
+        return false;
+    }
+    for (unsigned int i = 0; i < a.numCVs * 3; ++i) {
+        if (a.cvs[i] != b.cvs[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The cvs of curves within tolerance, on the calling thread. Cvs are
+// snapped to a grid of cells twice the tolerance wide, a cv looks at the 8
+// cells its neighbours can be in, like searchDoubleFaceTolerance. The
+// earliest matching cv is reported.
+inline void searchCurveSamePositionTolerance(
+    const std::vector<CurveView>& curves,
+    const double tolerance,
+    const bool withMatches,
+    CurveMatchScratch& scratch,
+    std::vector<unsigned int>& found,
+    std::vector<CurveMatch>& matches
+) {
+    const double inverse = 0.5 / tolerance;
+    const double tolerance2 = tolerance * tolerance;
+
+    size_t numCVs = 0;
+    for (unsigned int c = 0; c < curves.size(); ++c) {
+        numCVs += scratch.copies[c] ? 0 : curves[c].numCVs;
+    }
+    scratch.cellTable.reset(numCVs);
+    scratch.cells.clear();
+    scratch.cellNext.clear();
+
+    for (unsigned int c = 0; c < curves.size(); ++c) {
+        if (scratch.copies[c]) {
+            continue;
+        }
+        const CurveView& curve = curves[c];
+        for (unsigned int i = 0; i < curve.numCVs; ++i) {
+            const double* cv = curve.cvs + i * 3;
+            int64_t cell[3];
+            int64_t side[3];
+            for (int a = 0; a < 3; ++a) {
+                snapGridCell(cv[a] * inverse, cell[a], side[a]);
+            }
+
+            int match = -1;
+            for (int dx = 0; dx < 2; ++dx) {
+                for (int dy = 0; dy < 2; ++dy) {
+                    for (int dz = 0; dz < 2; ++dz) {
+                        const CurveCellTable::Slot& slot = scratch.cellTable.find(
+                            cell[0] + dx * side[0], cell[1] + dy * side[1], cell[2] + dz * side[2]);
+                        for (int other = slot.head; other >= 0; other = scratch.cellNext[other]) {
+                            if (match >= 0 && other > match) {
+                                continue;
+                            }
+                            const CurveMatchScratch::Entry& entry = scratch.cells[other];
+                            const double* p = curves[entry.curve].cvs + entry.cv * 3;
+                            const double x = p[0] - cv[0];
+                            const double y = p[1] - cv[1];
+                            const double z = p[2] - cv[2];
+                            if (x * x + y * y + z * z <= tolerance2) {
+                                match = other;
+                            }
+                        }
+                    }
+                }
+            }
+            if (match >= 0) {
+                const CurveMatchScratch::Entry& entry = scratch.cells[match];
+                found.push_back(c);
+                found.push_back(entry.curve);
+                if (withMatches) {
+                    matches.push_back({ entry.curve, static_cast<int>(entry.cv), c, static_cast<int>(i) });
+                }
+            }
+
+            CurveCellTable::Slot& slot = scratch.cellTable.find(cell[0], cell[1], cell[2]);
+            if (slot.head < 0) {
+                slot.x = cell[0];
+                slot.y = cell[1];
+                slot.z = cell[2];
+            }
+            scratch.cellNext.push_back(slot.head);
+            slot.head = static_cast<int>(scratch.cells.size());
+            scratch.cells.push_back({ c, i });
+        }
+    }
+}
+
+// Curves that have a cv at the same position as another cv, of another
+// curve or of the same one, in ascending order, each curve once. With
+// options.matches, matches gets every match, sorted.
+//
+// A curve that is a copy of an earlier curve is found by its fingerprint
+// first, both are reported and its cvs are skipped. The cvs of
+// numPartitions curve ranges are then hashed into partitions in parallel,
+// and every partition matches its cvs in its own table, in parallel too.
+// Equal positions always meet in the same partition, so nothing is shared
+// between workers. With a tolerance, neighbouring cells cross partitions,
+// the cvs are matched on the calling thread.
+//
+// parallelFor(n, body) must call body(i) for every i in [0, n) and return
+// once all calls are done.
+template<typename ParallelFor>
+void searchCurveSamePositionSplit(
+    const std::vector<CurveView>& curves,
+    const CurveMatchOptions& options,
+    const unsigned int numPartitions,
+    ParallelFor parallelFor,
+    CurveMatchScratch& scratch,
+    std::vector<unsigned int>& found,
+    std::vector<CurveMatch>& matches
+) {
+    const unsigned int numCurves = static_cast<unsigned int>(curves.size());
+    const unsigned int count = std::max(1u, std::min(numPartitions, numCurves));
+    const bool tolerance = options.tolerance > 0.0;
+
+    scratch.begins.resize(count + 1);
+    for (unsigned int r = 0; r <= count; ++r) {
+        scratch.begins[r] = static_cast<unsigned int>((unsigned long long)numCurves * r / count);
+    }
+    scratch.ranges.resize(count);
+    scratch.tables.resize(count);
+    scratch.partitionFound.resize(count);
+    scratch.partitionMatches.resize(count);
+    for (unsigned int p = 0; p < count; ++p) {
+        scratch.partitionFound[p].clear();
+        scratch.partitionMatches[p].clear();
+    }
+
+    // whole curve copies, before any cv.
+    scratch.fingerprints.resize(numCurves);
+    parallelFor(count, [&](unsigned int r) {
+        for (unsigned int c = scratch.begins[r]; c < scratch.begins[r + 1]; ++c) {
+            scratch.fingerprints[c] = curveFingerprint(curves[c]);
+        }
+    });
+
+    scratch.copies.assign(numCurves, 0);
+    scratch.copyFound.clear();
+    scratch.copyMatches.clear();
+    std::unordered_map<uint64_t, unsigned int> originals;
+    originals.reserve(numCurves);
+    for (unsigned int c = 0; c < numCurves; ++c) {
+        if (curves[c].numCVs == 0) {
+            continue;
+        }
+        auto inserted = originals.insert({ scratch.fingerprints[c], c });
+        const unsigned int original = inserted.first->second;
+        if (inserted.second || !sameCurveCVs(curves[original], curves[c])) {
+            continue;
+        }
+        scratch.copies[c] = 1;
+        scratch.copyFound.push_back(original);
+        scratch.copyFound.push_back(c);
+        if (options.matches) {
+            scratch.copyMatches.push_back({ original, -1, c, -1 });
+        }
+    }
+
+    if (tolerance) {
+        searchCurveSamePositionTolerance(curves, options.tolerance, options.matches, scratch,
+            scratch.partitionFound[0], scratch.partitionMatches[0]);
+    }
+    else {
+        // ranges: cvs into partitions.
+        parallelFor(count, [&](unsigned int r) {
+            auto& partitions = scratch.ranges[r];
+            partitions.resize(count);
+            for (auto& partition : partitions) {
+                partition.clear();
+            }
+            for (unsigned int c = scratch.begins[r]; c < scratch.begins[r + 1]; ++c) {
+                if (scratch.copies[c]) {
+                    continue;
+                }
+                const CurveView& curve = curves[c];
+                for (unsigned int i = 0; i < curve.numCVs; ++i) {
+                    const uint64_t hash = curvePositionHash(curve.cvs + i * 3);
+                    partitions[curvePartition(hash, count)].push_back({ c, i });
+                }
+            }
+        });
+
+        // partitions: match in curve order.
+        parallelFor(count, [&](unsigned int p) {
+            std::vector<unsigned int>& partitionFound = scratch.partitionFound[p];
+            std::vector<CurveMatch>& partitionMatches = scratch.partitionMatches[p];
+
+            size_t numCVs = 0;
+            for (unsigned int r = 0; r < count; ++r) {
+                numCVs += scratch.ranges[r][p].size();
+            }
+            CurvePositionTable& table = scratch.tables[p];
+            table.reset(numCVs);
+
+            for (unsigned int r = 0; r < count; ++r) {
+                for (const auto& entry : scratch.ranges[r][p]) {
+                    const double* cv = curves[entry.curve].cvs + entry.cv * 3;
+                    const uint64_t hash = curvePositionHash(cv);
+                    size_t i = static_cast<size_t>(hash) & table.mask;
+                    for (;; i = (i + 1) & table.mask) {
+                        CurvePositionTable::Slot& slot = table.slots[i];
+                        if (slot.curve < 0) {
+                            slot.hash = hash;
+                            slot.curve = static_cast<int>(entry.curve);
+                            slot.cv = entry.cv;
+                            break;
+                        }
+                        const double* other = curves[slot.curve].cvs + slot.cv * 3;
+                        if (slot.hash == hash && other[0] == cv[0] && other[1] == cv[1] && other[2] == cv[2]) {
+                            partitionFound.push_back(entry.curve);
+                            partitionFound.push_back(static_cast<unsigned int>(slot.curve));
+                            if (options.matches) {
+                                partitionMatches.push_back({ static_cast<unsigned int>(slot.curve), static_cast<int>(slot.cv),
+                                    entry.curve, static_cast<int>(entry.cv) });
+                            }
+                            break;
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    // repeats and curves found by several partitions collapse in the
+    // bitset, the found curves come out in order.
+    std::vector<uint64_t>& flagged = scratch.flagged;
+    flagged.assign((numCurves + 63) / 64, 0);
+    auto flag = [&](const std::vector<unsigned int>& curveIds) {
+        for (const auto& c : curveIds) {
+            flagged[c >> 6] |= 1ull << (c & 63);
+        }
+    };
+    flag(scratch.copyFound);
+    for (const auto& partitionFound : scratch.partitionFound) {
+        flag(partitionFound);
+    }
+    for (unsigned int w = 0; w < flagged.size(); ++w) {
+        for (uint64_t bits = flagged[w]; bits != 0; bits &= bits - 1) {
+            unsigned int bit = 0;
+            while (!((bits >> bit) & 1)) {
+                ++bit;
+            }
+            found.push_back(w * 64 + bit);
+        }
+    }
+
+    if (options.matches) {
+        const size_t first = matches.size();
+        matches.insert(matches.end(), scratch.copyMatches.begin(), scratch.copyMatches.end());
+        for (const auto& partitionMatches : scratch.partitionMatches) {
+            matches.insert(matches.end(), partitionMatches.begin(), partitionMatches.end());
+        }
+        std::sort(matches.begin() + first, matches.end());
+    }
+}
+
+// searchCurveSamePositionSplit on the calling thread.
+inline void searchCurveSamePosition(
+    const std::vector<CurveView>& curves,
+    std::vector<unsigned int>& found,
+    const CurveMatchOptions& options = CurveMatchOptions()
+) {
+    CurveMatchScratch scratch;
+    std::vector<CurveMatch> matches;
+    auto serialFor = [](const unsigned int n, const std::function<void(unsigned int)>& body) {
+        for (unsigned int i = 0; i < n; ++i) {
+            body(i);
+        }
+    };
+    searchCurveSamePositionSplit(curves, options, 1, serialFor, scratch, found, matches);
+}
+
+inline void searchCurveSpans0(
+    const std::vector<CurveView>& curves,
+    std::vector<unsigned int>& found
+) {
+    for (unsigned int c = 0; c < curves.size(); ++c) {
+        if (curves[c].numSpans == 0) {
+            found.push_back(c);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Flat, Maya independent view of a nurbs curve.
+//
+// cvs are xyz triples in world space, like MFnNurbsCurve::getCVs with
+// MSpace::kWorld. numCVs excludes the cvs a periodic curve repeats.
+
+#include <string>
+#include <vector>
+
+struct CurveView
+{
+    CurveView() : cvs(nullptr), numCVs(0), numSpans(0) {}
+
+    const double* cvs;
+    unsigned int numCVs;
+    int numSpans;
+};
+
+// Owning storage behind a CurveView, used where Maya is not available.
+struct CurveData
+{
+    std::string name;
+    std::vector<double> cvs;
+    int numSpans = 0;
+
+    CurveView view() const {
+        CurveView curve;
+        curve.cvs = cvs.data();
+        curve.numCVs = static_cast<unsigned int>(cvs.size() / 3);
+        curve.numSpans = numSpans;
+        return curve;
+    }
+};
@@ -0,0 +1,161 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Where a check command looks for shapes.
+//
+// Without -root and -selected the whole scene is traversed. Otherwise the
+// traversal starts at every -root node and every selected dag node, and a
+// path under overlapping roots is only returned once.
+
+#include <deque>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <maya/MArgList.h>
+#include <maya/MArgParser.h>
+#include <maya/MDagPath.h>
+#include <maya/MFn.h>
+#include <maya/MFnDagNode.h>
+#include <maya/MGlobal.h>
+#include <maya/MItDag.h>
+#include <maya/MSelectionList.h>
+#include <maya/MString.h>
+#include <maya/MSyntax.h>
+
+#include "checkUtils.h"
+
+namespace
+{
+    // root argument, multi use
+    const char *rootArgName = "-r";
+    const char *rootLongArgName = "-root";
+
+    // selected argument
+    const char *selectedArgName = "-sl";
+    const char *selectedLongArgName = "-selected";
+};
+
+typedef struct _dagScopeTag
+{
+    _dagScopeTag() : scoped(false) {}
+
+    // false: the whole scene.
+    bool scoped;
+    std::vector<MDagPath> roots;
+} DagScope;
+
+inline void addDagScopeFlags(MSyntax& syntax) {
+    syntax.addFlag(rootArgName, rootLongArgName, MSyntax::kString);
+    syntax.makeFlagMultiUse(rootArgName);
+    syntax.addFlag(selectedArgName, selectedLongArgName, MSyntax::kNoArg);
+}
+
+inline MStatus parseDagScopeFlags(
+    const MArgParser& argData,
+    DagScope& scope // out
+) {
+    MStatus stat = MStatus::kSuccess;
+    MSelectionList rootList;
+
+    const unsigned int numRoots = argData.numberOfFlagUses(rootArgName);
+    for (unsigned int i = 0; i < numRoots; ++i) {
+        MArgList rootArgs;
+        stat = argData.getFlagArgumentList(rootArgName, i, rootArgs);
+        CheckDisplayError(stat, "parseDagScopeFlags: could not get root argument data.");
+
+        const MString rootName = rootArgs.asString(0, &stat);
+        CheckDisplayError(stat, "parseDagScopeFlags: could not get root name.");
+
+        stat = rootList.add(rootName);
+        if (stat != MStatus::kSuccess) {
+            MGlobal::displayError("parseDagScopeFlags: " + rootName + " not found.");
+            return MStatus::kInvalidParameter;
+        }
+    }
+
+    const bool selected = argData.isFlagSet(selectedArgName);
+    if (selected) {
+        MSelectionList activeList;
+        stat = MGlobal::getActiveSelectionList(activeList);
+        CheckDisplayError(stat, "parseDagScopeFlags: could not get active selection list.");
+
+        stat = rootList.merge(activeList);
+        CheckDisplayError(stat, "parseDagScopeFlags: could not merge active selection list.");
+    }
+
+    scope.scoped = numRoots > 0 || selected;
+    scope.roots.clear();
+    for (unsigned int i = 0; i < rootList.length(); ++i) {
+        MDagPath root;
+        if (rootList.getDagPath(i, root) != MStatus::kSuccess) {
+            // not a dag node, like a set.
+            continue;
+        }
+        scope.roots.push_back(root);
+    }
+    return MStatus::kSuccess;
+}
+
+// Non intermediate paths of type in scope, depth first from each root.
+inline MStatus getScopedPaths(
+    const DagScope& scope,
+    const MFn::Type type,
+    std::deque<MDagPath>& paths // out
+) {
+    MStatus stat;
+    MItDag dagIter(MItDag::kDepthFirst, type, &stat);
+    CheckErrorReturn(stat, "getScopedPaths: could not create dagIter.");
+
+    // only several roots can overlap.
+    const bool dedupe = scope.roots.size() > 1;
+    std::unordered_set<std::string> visited;
+
+    const size_t numRoots = scope.scoped ? scope.roots.size() : 1;
+    for (size_t r = 0; r < numRoots; ++r) {
+        if (scope.scoped) {
+            stat = dagIter.reset(scope.roots[r], MItDag::kDepthFirst, type);
+            CheckErrorReturn(stat, "getScopedPaths: could not reset dagIter.");
+        }
+
+        MDagPath dagPath;
+        for (; !dagIter.isDone(); dagIter.next()) {
+            stat = dagIter.getPath(dagPath);
+            CheckErrorReturn(stat, "getScopedPaths: could not get dag path.");
+
+            MFnDagNode dagNode(dagPath, &stat);
+            CheckErrorReturn(stat, "getScopedPaths: could not get dag node.");
+
+            if (dagNode.isIntermediateObject()) {
+                continue;
+            }
+
+            if (dedupe && !visited.insert(dagPath.fullPathName().asChar()).second) {
+                continue;
+            }
+            paths.push_back(dagPath);
+        }
+    }
+    return stat;
+}
@@ -0,0 +1,344 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Center, normal and area of every face of a MeshView.
+//
+// The center is the average of the face vertices. The normal is the unit
+// Newell normal, zero for a degenerate face, and the area is half the
+// length of the Newell vector. Triangles use the cross product of two
+// edges and quads the cross product of the diagonals, which is the Newell
+// vector of those faces.
+//
+// All triangle and all quad meshes run on SIMD lanes, one face per lane:
+// 8 lanes with AVX2, 4 with SSE2. Mixed meshes, the remaining faces and
+// builds without either run the scalar code. Define MODELCHECK_NO_SIMD to
+// build the scalar code only.
+
+#include <cmath>
+#include <vector>
+
+#if !defined(MODELCHECK_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FACE_GEOMETRY_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FACE_GEOMETRY_SSE2 1
+#endif
+#endif
+
+#include "meshView.h"
+
+struct FaceGeometry
+{
+    // xyz per face.
+    std::vector<float> centers;
+    // unit xyz per face, zero for a degenerate face.
+    std::vector<float> normals;
+    std::vector<float> areas;
+};
+
+// 3 or 4 when every face of mesh has that many vertices, 0 otherwise.
+inline int uniformFaceSize(const MeshView& mesh) {
+    if (mesh.numFaces == 0) {
+        return 0;
+    }
+    const int count = mesh.faceCounts[0];
+    if ((count != 3 && count != 4) || mesh.numFaceVertices != mesh.numFaces * static_cast<unsigned int>(count)) {
+        return 0;
+    }
+    for (unsigned int f = 1; f < mesh.numFaces; ++f) {
+        if (mesh.faceCounts[f] != count) {
+            return 0;
+        }
+    }
+    return count;
+}
+
+// The geometry of a face from its Newell vector n and vertex sum.
+inline void storeFaceGeometry(
+    const float sum[3],
+    const float n[3],
+    const int count,
+    float* center,
+    float* normal,
+    float* area
+) {
+    const float scale = count > 0 ? 1.0f / count : 0.0f;
+    center[0] = sum[0] * scale;
+    center[1] = sum[1] * scale;
+    center[2] = sum[2] * scale;
+
+    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    const float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+    normal[0] = n[0] * inverse;
+    normal[1] = n[1] * inverse;
+    normal[2] = n[2] * inverse;
+    *area = 0.5f * length;
+}
+
+// One face with count vertices at connect.
+inline void faceGeometryScalar(
+    const float* points,
+    const int* connect,
+    const int count,
+    float* center,
+    float* normal,
+    float* area
+) {
+    float sum[3] = { 0.0f, 0.0f, 0.0f };
+    for (int v = 0; v < count; ++v) {
+        const float* p = points + 3 * connect[v];
+        sum[0] += p[0];
+        sum[1] += p[1];
+        sum[2] += p[2];
+    }
+
+    float n[3] = { 0.0f, 0.0f, 0.0f };
+    if (count == 3 || count == 4) {
+        // edges from vertex 0 for triangles, diagonals for quads.
+        const float* p0 = points + 3 * connect[0];
+        const float* p1 = points + 3 * connect[1];
+        const float* p2 = points + 3 * connect[2];
+        const float* pLast = points + 3 * connect[count - 1];
+        const float* a1 = count == 3 ? p1 : p2;
+        const float* b0 = count == 3 ? p0 : p1;
+        const float a[3] = { a1[0] - p0[0], a1[1] - p0[1], a1[2] - p0[2] };
+        const float b[3] = { pLast[0] - b0[0], pLast[1] - b0[1], pLast[2] - b0[2] };
+        n[0] = a[1] * b[2] - a[2] * b[1];
+        n[1] = a[2] * b[0] - a[0] * b[2];
+        n[2] = a[0] * b[1] - a[1] * b[0];
+    }
+    else if (count > 4) {
+        // Newell, relative to vertex 0 to keep the precision far from the
+        // origin.
+        const float* origin = points + 3 * connect[0];
+        for (int v = 0; v < count; ++v) {
+            const float* p = points + 3 * connect[v];
+            const float* q = points + 3 * connect[v + 1 < count ? v + 1 : 0];
+            const float px = p[0] - origin[0], py = p[1] - origin[1], pz = p[2] - origin[2];
+            const float qx = q[0] - origin[0], qy = q[1] - origin[1], qz = q[2] - origin[2];
+            n[0] += (py - qy) * (pz + qz);
+            n[1] += (pz - qz) * (px + qx);
+            n[2] += (px - qx) * (py + qy);
+        }
+    }
+
+    storeFaceGeometry(sum, n, count, center, normal, area);
+}
+
+// Faces [begin, end) of mesh, any face size. offset is the index into
+// mesh.faceConnects of the first vertex of face begin.
+inline void computeFaceGeometryRange(
+    const MeshView& mesh,
+    const unsigned int begin,
+    const unsigned int end,
+    unsigned int offset,
+    FaceGeometry& geometry
+) {
+    for (unsigned int f = begin; f < end; ++f) {
+        const int count = mesh.faceCounts[f];
+        faceGeometryScalar(mesh.points, mesh.faceConnects + offset, count,
+            &geometry.centers[f * 3], &geometry.normals[f * 3], &geometry.areas[f]);
+        offset += count;
+    }
+}
+
+#if defined(FACE_GEOMETRY_AVX2) || defined(FACE_GEOMETRY_SSE2)
+
+// x, y and z of 4 faces to 4 xyz triples at out.
+inline void storeTriples4(float* out, const __m128 x, const __m128 y, const __m128 z) {
+    const __m128 xyLow = _mm_unpacklo_ps(x, y);
+    const __m128 xyHigh = _mm_unpackhi_ps(x, y);
+    const __m128 yzLow = _mm_unpacklo_ps(y, z);
+    const __m128 yzHigh = _mm_unpackhi_ps(y, z);
+    const __m128 zxLow = _mm_unpacklo_ps(z, x);
+    const __m128 zxHigh = _mm_unpackhi_ps(z, x);
+    _mm_storeu_ps(out + 0, _mm_shuffle_ps(xyLow, zxLow, _MM_SHUFFLE(3, 0, 1, 0)));
+    _mm_storeu_ps(out + 4, _mm_shuffle_ps(yzLow, xyHigh, _MM_SHUFFLE(1, 0, 3, 2)));
+    _mm_storeu_ps(out + 8, _mm_shuffle_ps(zxHigh, yzHigh, _MM_SHUFFLE(3, 2, 3, 0)));
+}
+
+#if defined(FACE_GEOMETRY_AVX2)
+// 8 faces, one per lane.
+struct FaceLanes
+{
+    static const int width = 8;
+    __m256 v;
+
+    FaceLanes() {}
+    FaceLanes(const __m256 value) : v(value) {}
+
+    static FaceLanes constant(const float value) { return _mm256_set1_ps(value); }
+
+    // xyz of vertex k of faces [face, face + 8) of size count. Scalar
+    // loads, hardware gathers are slower here.
+    static void gather(const float* points, const int* connects, const unsigned int face, const int count, const int k, FaceLanes p[3]) {
+        const int* connect = connects + face * count + k;
+        const float* q[8];
+        for (int l = 0; l < 8; ++l) {
+            q[l] = points + 3 * connect[l * count];
+        }
+        p[0] = _mm256_setr_ps(q[0][0], q[1][0], q[2][0], q[3][0], q[4][0], q[5][0], q[6][0], q[7][0]);
+        p[1] = _mm256_setr_ps(q[0][1], q[1][1], q[2][1], q[3][1], q[4][1], q[5][1], q[6][1], q[7][1]);
+        p[2] = _mm256_setr_ps(q[0][2], q[1][2], q[2][2], q[3][2], q[4][2], q[5][2], q[6][2], q[7][2]);
+    }
+
+    void store(float* out) const { _mm256_storeu_ps(out, v); }
+};
+
+inline void storeTriples(float* out, const FaceLanes& x, const FaceLanes& y, const FaceLanes& z) {
+    storeTriples4(out, _mm256_castps256_ps128(x.v), _mm256_castps256_ps128(y.v), _mm256_castps256_ps128(z.v));
+    storeTriples4(out + 12, _mm256_extractf128_ps(x.v, 1), _mm256_extractf128_ps(y.v, 1), _mm256_extractf128_ps(z.v, 1));
+}
+
+inline FaceLanes operator+(const FaceLanes& a, const FaceLanes& b) { return _mm256_add_ps(a.v, b.v); }
+inline FaceLanes operator-(const FaceLanes& a, const FaceLanes& b) { return _mm256_sub_ps(a.v, b.v); }
+inline FaceLanes operator*(const FaceLanes& a, const FaceLanes& b) { return _mm256_mul_ps(a.v, b.v); }
+inline FaceLanes laneSqrt(const FaceLanes& a) { return _mm256_sqrt_ps(a.v); }
+// 1 / a where a > 0, 0 elsewhere.
+inline FaceLanes laneInverse(const FaceLanes& a) {
+    const __m256 positive = _mm256_cmp_ps(a.v, _mm256_setzero_ps(), _CMP_GT_OQ);
+    return _mm256_and_ps(positive, _mm256_div_ps(_mm256_set1_ps(1.0f), a.v));
+}
+#else
+// 4 faces, one per lane.
+struct FaceLanes
+{
+    static const int width = 4;
+    __m128 v;
+
+    FaceLanes() {}
+    FaceLanes(const __m128 value) : v(value) {}
+
+    static FaceLanes constant(const float value) { return _mm_set1_ps(value); }
+
+    // xyz of vertex k of faces [face, face + 4) of size count.
+    static void gather(const float* points, const int* connects, const unsigned int face, const int count, const int k, FaceLanes p[3]) {
+        const int* connect = connects + face * count + k;
+        const float* p0 = points + 3 * connect[0];
+        const float* p1 = points + 3 * connect[count];
+        const float* p2 = points + 3 * connect[2 * count];
+        const float* p3 = points + 3 * connect[3 * count];
+        p[0] = _mm_setr_ps(p0[0], p1[0], p2[0], p3[0]);
+        p[1] = _mm_setr_ps(p0[1], p1[1], p2[1], p3[1]);
+        p[2] = _mm_setr_ps(p0[2], p1[2], p2[2], p3[2]);
+    }
+
+    void store(float* out) const { _mm_storeu_ps(out, v); }
+};
+
+inline void storeTriples(float* out, const FaceLanes& x, const FaceLanes& y, const FaceLanes& z) {
+    storeTriples4(out, x.v, y.v, z.v);
+}
+
+inline FaceLanes operator+(const FaceLanes& a, const FaceLanes& b) { return _mm_add_ps(a.v, b.v); }
+inline FaceLanes operator-(const FaceLanes& a, const FaceLanes& b) { return _mm_sub_ps(a.v, b.v); }
+inline FaceLanes operator*(const FaceLanes& a, const FaceLanes& b) { return _mm_mul_ps(a.v, b.v); }
+inline FaceLanes laneSqrt(const FaceLanes& a) { return _mm_sqrt_ps(a.v); }
+// 1 / a where a > 0, 0 elsewhere.
+inline FaceLanes laneInverse(const FaceLanes& a) {
+    const __m128 positive = _mm_cmpgt_ps(a.v, _mm_setzero_ps());
+    return _mm_and_ps(positive, _mm_div_ps(_mm_set1_ps(1.0f), a.v));
+}
+#endif
+
+// Faces [0, end) of an all Count vertex mesh, end a multiple of the lane
+// width. Same arithmetic as faceGeometryScalar.
+template <int Count>
+inline void computeFaceGeometryLanes(
+    const MeshView& mesh,
+    const unsigned int end,
+    FaceGeometry& geometry
+) {
+    const int width = FaceLanes::width;
+    const FaceLanes scale = FaceLanes::constant(1.0f / Count);
+    const FaceLanes half = FaceLanes::constant(0.5f);
+
+    for (unsigned int face = 0; face < end; face += width) {
+        FaceLanes p[Count][3];
+        for (int k = 0; k < Count; ++k) {
+            FaceLanes::gather(mesh.points, mesh.faceConnects, face, Count, k, p[k]);
+        }
+
+        FaceLanes sum[3];
+        FaceLanes a[3];
+        FaceLanes b[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            sum[axis] = p[0][axis] + p[1][axis] + p[2][axis];
+            if (Count == 3) {
+                a[axis] = p[1][axis] - p[0][axis];
+                b[axis] = p[2][axis] - p[0][axis];
+            }
+            else {
+                sum[axis] = sum[axis] + p[Count - 1][axis];
+                a[axis] = p[2][axis] - p[0][axis];
+                b[axis] = p[Count - 1][axis] - p[1][axis];
+            }
+        }
+
+        const FaceLanes nx = a[1] * b[2] - a[2] * b[1];
+        const FaceLanes ny = a[2] * b[0] - a[0] * b[2];
+        const FaceLanes nz = a[0] * b[1] - a[1] * b[0];
+        const FaceLanes length = laneSqrt(nx * nx + ny * ny + nz * nz);
+        const FaceLanes inverse = laneInverse(length);
+
+        storeTriples(&geometry.centers[face * 3], sum[0] * scale, sum[1] * scale, sum[2] * scale);
+        storeTriples(&geometry.normals[face * 3], nx * inverse, ny * inverse, nz * inverse);
+        (length * half).store(&geometry.areas[face]);
+    }
+}
+
+#endif
+
+// Scalar code for every face, the reference of computeFaceGeometry.
+inline void computeFaceGeometryScalar(const MeshView& mesh, FaceGeometry& geometry) {
+    geometry.centers.resize(mesh.numFaces * 3);
+    geometry.normals.resize(mesh.numFaces * 3);
+    geometry.areas.resize(mesh.numFaces);
+    computeFaceGeometryRange(mesh, 0, mesh.numFaces, 0, geometry);
+}
+
+inline void computeFaceGeometry(const MeshView& mesh, FaceGeometry& geometry) {
+    geometry.centers.resize(mesh.numFaces * 3);
+    geometry.normals.resize(mesh.numFaces * 3);
+    geometry.areas.resize(mesh.numFaces);
+
+    unsigned int begin = 0;
+#if defined(FACE_GEOMETRY_AVX2) || defined(FACE_GEOMETRY_SSE2)
+    const int count = uniformFaceSize(mesh);
+    begin = count > 0 ? mesh.numFaces - mesh.numFaces % FaceLanes::width : 0;
+    if (count == 3) {
+        computeFaceGeometryLanes<3>(mesh, begin, geometry);
+    }
+    else if (count == 4) {
+        computeFaceGeometryLanes<4>(mesh, begin, geometry);
+    }
+    const unsigned int offset = begin * static_cast<unsigned int>(count);
+#else
+    const unsigned int offset = 0;
+#endif
+    computeFaceGeometryRange(mesh, begin, mesh.numFaces, offset, geometry);
+}
@@ -0,0 +1,1414 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Shared mesh check runner.
+//
+// Every checkMesh* plugin and the modelCheck command use this header.
+// The mesh list is collected once, each worker binds the data of a mesh
+// into a MeshView once and runs every requested kernel of meshKernels.h on
+// it. With -allUVSet every uv set of a mesh is its own item, so the uv
+// sets of one mesh run on several workers. Meshes with at least splitFaces
+// faces are checked afterwards on face ranges in parallel. Workers write
+// results as flat (mesh, face) index buffers, the selection lists are
+// built from them once at the end.
+// With -cache, meshes unchanged since the last run reuse their results,
+// see meshCheckCache.h. With -crossMesh, double faces are also searched
+// across meshes, see crossMesh.h.
+
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <maya/MString.h>
+#include <maya/MStringArray.h>
+#include <maya/MFn.h>
+#include <maya/MFnDagNode.h>
+#include <maya/MFnDependencyNode.h>
+#include <maya/MFnMesh.h>
+#include <maya/MFnSingleIndexedComponent.h>
+#include <maya/MItDag.h>
+#include <maya/MObjectHandle.h>
+#include <maya/MGlobal.h>
+#include <maya/MDagPath.h>
+#include <maya/MPlug.h>
+#include <maya/MFloatArray.h>
+#include <maya/MIntArray.h>
+#include <maya/MMatrix.h>
+#include <maya/MSelectionList.h>
+#include <maya/MThreadPool.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgParser.h>
+
+#include "checkUtils.h"
+#include "crossMesh.h"
+#include "dagScope.h"
+#include "meshCheckCache.h"
+#include "meshKernels.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "threadPoolFor.h"
+
+namespace
+{
+    // flags shared by every mesh check command.
+
+    // worker stats argument
+    const char *workerStatsArgName = "-ws";
+    const char *workerStatsLongArgName = "-workerStats";
+
+    // split faces argument
+    const char *splitFacesArgName = "-sf";
+    const char *splitFacesLongArgName = "-splitFaces";
+
+    // profile argument
+    const char *profileArgName = "-p";
+    const char *profileLongArgName = "-profile";
+
+    // profile meshes argument
+    const char *profileMeshesArgName = "-pm";
+    const char *profileMeshesLongArgName = "-profileMeshes";
+
+    // cache argument
+    const char *cacheArgName = "-ca";
+    const char *cacheLongArgName = "-cache";
+
+    // cache info argument
+    const char *cacheInfoArgName = "-ci";
+    const char *cacheInfoLongArgName = "-cacheInfo";
+
+    // flush cache argument
+    const char *flushCacheArgName = "-fc";
+    const char *flushCacheLongArgName = "-flushCache";
+
+    // expand instances argument
+    const char *expandInstancesArgName = "-ei";
+    const char *expandInstancesLongArgName = "-expandInstances";
+
+    // tolerance argument
+    const char *toleranceArgName = "-tol";
+    const char *toleranceLongArgName = "-tolerance";
+
+    // cross mesh argument
+    const char *crossMeshArgName = "-cm";
+    const char *crossMeshLongArgName = "-crossMesh";
+};
+
+// Flat results of one worker. Hit i of a check is face components[i] of
+// meshArray[meshes[i]], or the whole mesh when the component is -1. Uv tiling
+// over with MeshKernelOptions::tilingOverUVs has uv components. A mesh
+// is checked by one worker only, so the hits of a mesh are contiguous,
+// except for -crossMesh hits which name the other mesh too.
+// doubleFaceGroups holds mesh, count, face ids... per double face group,
+// with MeshKernelOptions::doubleFaceGroups. udimReports[i] is a uv set of
+// meshArray[udimMeshes[i]], with MeshKernelOptions::udimReport.
+typedef struct _meshCheckHitsTag {
+    std::vector<unsigned int> meshes[kMeshCheckCount];
+    std::vector<int>          components[kMeshCheckCount];
+    std::vector<int>          doubleFaceGroups;
+    std::vector<unsigned int> udimMeshes;
+    std::vector<UDIMReport>   udimReports;
+} MeshCheckHits;
+
+typedef struct _meshCheckTaskTag
+{
+    _meshCheckTaskTag()
+        : uvSet("map1")
+        , allUVSet(false)
+        , workerStats(false)
+        , splitFaces(kDefaultSplitFaces)
+        , useCache(false)
+        , cacheInfo(false)
+        , flushCache(false)
+        , expandInstances(false)
+        , crossMesh(false)
+        , cacheHits(0)
+    {}
+
+    // flags
+    MString      uvSet;
+    bool         allUVSet;
+    bool         workerStats;
+    unsigned int splitFaces;
+    bool         useCache;
+    bool         cacheInfo;
+    bool         flushCache;
+    bool         expandInstances;
+    bool         crossMesh;
+    DagScope     scope;
+    MeshKernelOptions kernelOptions;
+    std::vector<MeshCheckKind> checks;
+
+    // step 1, one path per mesh shape node. The other paths of an
+    // instanced shape are in instancePaths, they are not checked again.
+    std::deque<MDagPath> meshArray;
+    std::vector<std::vector<MDagPath>> instancePaths;
+    // items run by the scheduler: a mesh, its uv set, and their costs.
+    // uv set -1 is every uv set. With allUVSet a mesh with several uv sets
+    // is one item per uv set, the item of uv set 0 also runs the checks
+    // without uvs, the others run uvChecks.
+    std::vector<unsigned int> scheduledMeshes;
+    std::vector<int>          scheduledUVSets;
+    std::vector<double>       meshCosts;
+    std::vector<MeshCheckKind> uvChecks;
+    // seconds per item, with the profiler.
+    std::vector<double>       scheduledSec;
+    // meshes with at least splitFaces faces, run on face ranges.
+    std::vector<unsigned int> splitMeshes;
+    // meshes whose results come from the cache, per mesh.
+    std::vector<unsigned char> cachedMeshes;
+    unsigned int cacheHits;
+
+    // step 2
+    WorkScheduler  scheduler;
+    Profiler       profiler;
+    CrossMeshTable crossMeshTable;
+    // faces of every mesh the cross mesh search bound, per mesh. Written
+    // by the worker of the mesh only, the table reads them afterwards.
+    std::vector<CrossMeshFaces> crossMeshFaces;
+    // cached results, one per worker, then one for the split meshes.
+    std::vector<MeshCheckHits> hits;
+    // with kernelOptions.doubleFaceGroups, in mesh order:
+    // "mesh.f[a] mesh.f[b]..." per group of double faces.
+    MStringArray doubleFaceGroups;
+    // with kernelOptions.udimReport, every checked mesh in mesh order:
+    // "mesh uvSet udim udim..." per uv set, "outside" at the end when uvs
+    // are off the UDIM grid, and "mesh uvSet shell minU maxU minV maxV"
+    // per uv shell.
+    MStringArray udims;
+    MStringArray udimShells;
+
+    // step 4
+    MSelectionList invalidLists[kMeshCheckCount];
+
+    MStatus stat;
+} MeshCheckTask;
+
+inline void addMeshCheckFlags(MSyntax& syntax) {
+    syntax.addFlag(workerStatsArgName, workerStatsLongArgName, MSyntax::kNoArg);
+    syntax.addFlag(splitFacesArgName, splitFacesLongArgName, MSyntax::kLong);
+    syntax.addFlag(profileArgName, profileLongArgName, MSyntax::kNoArg);
+    syntax.addFlag(profileMeshesArgName, profileMeshesLongArgName, MSyntax::kLong);
+    syntax.addFlag(cacheArgName, cacheLongArgName, MSyntax::kNoArg);
+    syntax.addFlag(cacheInfoArgName, cacheInfoLongArgName, MSyntax::kNoArg);
+    syntax.addFlag(flushCacheArgName, flushCacheLongArgName, MSyntax::kNoArg);
+    syntax.addFlag(expandInstancesArgName, expandInstancesLongArgName, MSyntax::kNoArg);
+    addDagScopeFlags(syntax);
+}
+
+// -tolerance and -crossMesh, for the commands that run the double face
+// check.
+inline void addDoubleFaceFlags(MSyntax& syntax) {
+    syntax.addFlag(toleranceArgName, toleranceLongArgName, MSyntax::kDouble);
+    syntax.addFlag(crossMeshArgName, crossMeshLongArgName, MSyntax::kNoArg);
+}
+
+inline MStatus parseMeshCheckFlags(
+    const MArgParser& argData,
+    MeshCheckTask& task // out
+) {
+    MStatus stat = MStatus::kSuccess;
+
+    if (argData.isFlagSet(workerStatsArgName)) {
+        task.workerStats = true;
+    }
+
+    if (argData.isFlagSet(splitFacesArgName)) {
+        int splitFaces = 0;
+        stat = argData.getFlagArgument(splitFacesArgName, 0, splitFaces);
+        CheckDisplayError(stat, "parseMeshCheckFlags: could not get splitFaces argument data.");
+        if (splitFaces < 0) {
+            MGlobal::displayError("parseMeshCheckFlags: splitFaces must be 0 or greater.");
+            return MStatus::kInvalidParameter;
+        }
+        task.splitFaces = static_cast<unsigned int>(splitFaces);
+    }
+
+    if (argData.isFlagSet(profileArgName)) {
+        int profileMeshes = 10;
+        if (argData.isFlagSet(profileMeshesArgName)) {
+            stat = argData.getFlagArgument(profileMeshesArgName, 0, profileMeshes);
+            CheckDisplayError(stat, "parseMeshCheckFlags: could not get profileMeshes argument data.");
+            if (profileMeshes < 0) {
+                MGlobal::displayError("parseMeshCheckFlags: profileMeshes must be 0 or greater.");
+                return MStatus::kInvalidParameter;
+            }
+        }
+        task.profiler.enable(static_cast<unsigned int>(profileMeshes));
+    }
+
+    task.useCache = argData.isFlagSet(cacheArgName);
+    task.cacheInfo = argData.isFlagSet(cacheInfoArgName);
+    task.flushCache = argData.isFlagSet(flushCacheArgName);
+    task.expandInstances = argData.isFlagSet(expandInstancesArgName);
+
+    return parseDagScopeFlags(argData, task.scope);
+}
+
+// Call after parseMeshCheckFlags, with task.checks set.
+inline MStatus parseDoubleFaceFlags(
+    const MArgParser& argData,
+    MeshCheckTask& task // out
+) {
+    MStatus stat = MStatus::kSuccess;
+
+    if (argData.isFlagSet(toleranceArgName)) {
+        double tolerance = 0.0;
+        stat = argData.getFlagArgument(toleranceArgName, 0, tolerance);
+        CheckDisplayError(stat, "parseDoubleFaceFlags: could not get tolerance argument data.");
+        if (!isValidTolerance(tolerance)) {
+            MGlobal::displayError("parseDoubleFaceFlags: tolerance must be 0, or between 1e-12 and the largest double.");
+            return MStatus::kInvalidParameter;
+        }
+        task.kernelOptions.tolerance = tolerance;
+    }
+
+    if (argData.isFlagSet(crossMeshArgName)) {
+        task.crossMesh = true;
+        const bool hasDoubleFace =
+            std::find(task.checks.begin(), task.checks.end(), kMeshDoubleFace) != task.checks.end();
+        if (task.useCache && hasDoubleFace) {
+            // cross mesh results depend on the other meshes.
+            MGlobal::displayWarning("parseDoubleFaceFlags: -cache is ignored with -crossMesh.");
+            task.useCache = false;
+        }
+    }
+    return stat;
+}
+
+// step 1, the meshes in task.scope grouped by shape node.
+inline MStatus getAllMesh(
+    MeshCheckTask& task // in out
+) {
+    std::deque<MDagPath> paths;
+    task.stat = getScopedPaths(task.scope, MFn::kMesh, paths);
+    CheckDisplayError(task.stat, "getAllMesh: could not get mesh paths.");
+
+    // MObjectHandle::hashCode to the meshes with that hash code.
+    std::unordered_map<unsigned int, std::vector<unsigned int>> instanced;
+    for (const auto& dagPath : paths) {
+        const bool isInstanced = dagPath.isInstanced(&task.stat);
+        CheckDisplayError(task.stat, "getAllMesh: could not get isInstanced.");
+
+        if (isInstanced) {
+            const MObjectHandle handle(dagPath.node());
+            auto& meshes = instanced[handle.hashCode()];
+            bool found = false;
+            for (const auto& index : meshes) {
+                if (MObjectHandle(task.meshArray[index].node()) == handle) {
+                    task.instancePaths[index].push_back(dagPath);
+                    found = true;
+                    break;
+                }
+            }
+            if (found) {
+                continue;
+            }
+            meshes.push_back(static_cast<unsigned int>(task.meshArray.size()));
+        }
+
+        task.meshArray.push_back(dagPath);
+        task.instancePaths.emplace_back();
+    }
+    return task.stat;
+}
+
+// Settings a cached result of kind depends on.
+inline std::string meshCheckCacheKey(const MeshCheckTask& task, const MeshCheckKind kind) {
+    if (isUVCheck(kind)) {
+        const std::string key = task.allUVSet ? std::string("uv:*") : std::string("uv:") + task.uvSet.asChar();
+        return kind == kMeshUVTilingOver && task.kernelOptions.tilingOverUVs ? key + ":uvs" : key;
+    }
+    if (kind == kMeshDoubleFace) {
+        char key[64];
+        snprintf(key, sizeof(key), "tol:%.17g", task.kernelOptions.tolerance);
+        return key;
+    }
+    return std::string("-");
+}
+
+// step 1, take the results of clean cached meshes into their own hits
+// buffer. A mesh is only taken when every check of task is cached.
+inline void lookupMeshCheckCache(
+    MeshCheckTask& task // in out
+) {
+    MeshCheckCache& cache = meshCheckCache();
+    cache.prune();
+
+    std::vector<std::string> keys;
+    for (const auto& kind : task.checks) {
+        keys.push_back(meshCheckCacheKey(task, kind));
+    }
+
+    task.cachedMeshes.assign(task.meshArray.size(), 0);
+    task.cacheHits = 0;
+    task.hits.emplace_back();
+    MeshCheckHits& hits = task.hits.back();
+    for (unsigned int i = 0; i < task.meshArray.size(); ++i) {
+        const MeshCheckCacheEntry* entry = cache.find(task.meshArray[i].node());
+        if (entry == nullptr) {
+            continue;
+        }
+
+        bool cached = true;
+        for (size_t k = 0; k < task.checks.size(); ++k) {
+            cached &= entry->keys[task.checks[k]] == keys[k];
+        }
+        if (!cached) {
+            continue;
+        }
+
+        for (const auto& kind : task.checks) {
+            if (!entry->invalid[kind]) {
+                continue;
+            }
+
+            if (!entry->faces[kind].empty()) {
+                const auto& faces = entry->faces[kind];
+                hits.meshes[kind].insert(hits.meshes[kind].end(), faces.size(), i);
+                hits.components[kind].insert(hits.components[kind].end(), faces.begin(), faces.end());
+            }
+            else {
+                hits.meshes[kind].push_back(i);
+                hits.components[kind].push_back(-1);
+            }
+        }
+        task.cachedMeshes[i] = 1;
+        ++task.cacheHits;
+    }
+}
+
+inline bool hasCrossMeshCheck(const MeshCheckTask* task) {
+    return task->crossMesh
+        && std::find(task->checks.begin(), task->checks.end(), kMeshDoubleFace) != task->checks.end();
+}
+
+// step 1, estimate the cost of every mesh for the scheduler and put
+// large meshes aside for the face range split.
+inline MStatus getMeshCosts(
+    MeshCheckTask& task // in out
+) {
+    bool hasUVCheck = false;
+    bool hasSplitCheck = false;
+    task.uvChecks.clear();
+    for (const auto& kind : task.checks) {
+        hasUVCheck |= isUVCheck(kind);
+        hasSplitCheck |= isSplitMeshCheck(kind);
+        if (isUVCheck(kind)) {
+            task.uvChecks.push_back(kind);
+        }
+    }
+
+    const bool crossMesh = hasCrossMeshCheck(&task);
+    size_t crossMeshInstances = 0;
+    size_t crossMeshFaces = 0;
+
+    task.scheduledMeshes.clear();
+    task.scheduledUVSets.clear();
+    task.meshCosts.clear();
+    task.splitMeshes.clear();
+    for (unsigned int i = 0; i < task.meshArray.size(); ++i) {
+        MFnMesh fnMesh(task.meshArray[i], &task.stat);
+        CheckDisplayError(task.stat, "getMeshCosts: could not create MFnMesh.");
+
+        if (task.kernelOptions.tilingOverUVs) {
+            // uv components index the uvs of the current uv set.
+            MStringArray uvSetNames;
+            task.stat = fnMesh.getUVSetNames(uvSetNames);
+            CheckDisplayError(task.stat, "getMeshCosts: could not get uv set names.");
+            if (uvSetNames.indexOf(task.uvSet) != -1 && fnMesh.currentUVSetName() != task.uvSet) {
+                MGlobal::displayError("getMeshCosts: -uvComponents needs " + task.uvSet
+                    + " to be the current uv set of " + task.meshArray[i].partialPathName() + ".");
+                task.stat = MStatus::kInvalidParameter;
+                return task.stat;
+            }
+        }
+
+        if (task.useCache && task.cachedMeshes[i]) {
+            continue;
+        }
+
+        const int numPolygons = fnMesh.numPolygons(&task.stat);
+        CheckDisplayError(task.stat, "getMeshCosts: could not get num polygons.");
+
+        if (crossMesh) {
+            const size_t numInstances = task.instancePaths[i].size() + 1;
+            crossMeshInstances += numInstances;
+            crossMeshFaces += numInstances * static_cast<size_t>(numPolygons);
+        }
+
+        if (hasSplitCheck && task.splitFaces > 0 && static_cast<unsigned int>(numPolygons) >= task.splitFaces) {
+            task.splitMeshes.push_back(i);
+            continue;
+        }
+
+        const int numFaceVertices = fnMesh.numFaceVertices(&task.stat);
+        CheckDisplayError(task.stat, "getMeshCosts: could not get num face vertices.");
+
+        int numUVSets = 0;
+        if (hasUVCheck) {
+            numUVSets = task.allUVSet ? fnMesh.numUVSets(&task.stat) : 1;
+            CheckDisplayError(task.stat, "getMeshCosts: could not get num uv sets.");
+        }
+
+        if (task.allUVSet && numUVSets > 1 && numPolygons > 0) {
+            // the uv sets of the mesh run in parallel, each binds its own.
+            for (int s = 0; s < numUVSets; ++s) {
+                task.scheduledMeshes.push_back(i);
+                task.scheduledUVSets.push_back(s);
+                task.meshCosts.push_back(s == 0
+                    ? estimateMeshCost(numPolygons, numFaceVertices, 1)
+                    : estimateMeshCost(0, numFaceVertices, 1));
+            }
+            continue;
+        }
+
+        task.scheduledMeshes.push_back(i);
+        task.scheduledUVSets.push_back(-1);
+        task.meshCosts.push_back(estimateMeshCost(numPolygons, numFaceVertices, numUVSets));
+    }
+
+    if (crossMesh) {
+        task.crossMeshTable.reserve(crossMeshInstances, crossMeshFaces);
+        task.crossMeshFaces.resize(task.meshArray.size());
+    }
+    return task.stat;
+}
+
+typedef struct _uvSetBindingTag {
+    MFloatArray  u;
+    MFloatArray  v;
+    MIntArray    uvCounts;
+    MIntArray    uvIds;
+    // labelled by computeUVShellIds, for every check on the mesh.
+    std::vector<int> shellIds;
+    std::vector<int> shellParents;
+    unsigned int numShells;
+} UVSetBinding;
+
+// Maya arrays behind the MeshView of one mesh. Reused between meshes.
+// Points are not copied, the view points into the mesh data.
+typedef struct _meshBindingTag {
+    MIntArray faceCounts;
+    MIntArray faceConnects;
+    std::vector<float> tweaks;
+    std::vector<unsigned char> normalLocked;
+    std::vector<UVSetBinding> uvSets;
+    MeshView view;
+} MeshBinding;
+
+inline const int* arrayData(MIntArray& array) {
+    return array.length() > 0 ? &array[0] : nullptr;
+}
+
+inline const float* arrayData(MFloatArray& array) {
+    return array.length() > 0 ? &array[0] : nullptr;
+}
+
+#ifdef _DEBUG
+// shellIds and the ids of getUvShellsIds must make the same shells, the
+// numbering may differ.
+inline void validateUVShellIds(
+    MFnMesh& fnMesh,
+    const MString& uvSetName,
+    const std::vector<int>& shellIds,
+    const unsigned int numShells
+) {
+    MIntArray mayaIds;
+    unsigned int numMayaShells = 0;
+    if (fnMesh.getUvShellsIds(mayaIds, numMayaShells, &uvSetName) != MStatus::kSuccess) {
+        return;
+    }
+
+    bool same = numMayaShells == numShells && mayaIds.length() == shellIds.size();
+    std::vector<int> toMaya(numShells, -1);
+    for (unsigned int i = 0; same && i < shellIds.size(); ++i) {
+        int& mapped = toMaya[shellIds[i]];
+        if (mapped < 0) {
+            mapped = mayaIds[i];
+        }
+        same = mapped == mayaIds[i];
+    }
+    if (!same) {
+        cerr << "validateUVShellIds: " << fnMesh.name().asChar() << "." << uvSetName.asChar()
+            << " shells differ from getUvShellsIds.\n";
+    }
+}
+#endif // _DEBUG
+
+// Fetch the data needed by checks into binding and point binding.view at it.
+// Without labelShells the uv shells are left to the kernels, a split mesh
+// labels them on its face ranges.
+inline MStatus bindMesh(
+    const MDagPath& dagPath,
+    MFnMesh& fnMesh,
+    const int numPolygons,
+    const std::vector<MeshCheckKind>& checks,
+    const MStringArray& uvSets,
+    const bool labelShells,
+    MeshBinding& binding
+) {
+    MStatus stat;
+    MeshView& view = binding.view;
+    view = MeshView();
+    view.numFaces = static_cast<unsigned int>(numPolygons);
+
+    bool needGeometry = false;
+    bool needShells = false;
+    bool needTweaks = false;
+    bool needNormals = false;
+    for (const auto& kind : checks) {
+        needGeometry |= kind == kMeshDoubleFace;
+        needShells |= kind == kMeshUVTilingOver;
+        needTweaks |= kind == kMeshFreeze;
+        needNormals |= kind == kMeshNormalLock;
+    }
+
+    if (needGeometry && numPolygons > 0) {
+        // object space xyz per vertex, valid until the mesh changes.
+        view.points = fnMesh.getRawPoints(&stat);
+        CheckErrorReturn(stat, "bindMesh: could not get raw points.");
+
+        view.numVertices = static_cast<unsigned int>(fnMesh.numVertices(&stat));
+        CheckErrorReturn(stat, "bindMesh: could not get num vertices.");
+
+        stat = fnMesh.getVertices(binding.faceCounts, binding.faceConnects);
+        CheckErrorReturn(stat, "bindMesh: could not get vertices.");
+
+        view.faceCounts = arrayData(binding.faceCounts);
+        view.faceConnects = arrayData(binding.faceConnects);
+        view.numFaceVertices = binding.faceConnects.length();
+    }
+
+    if (needTweaks) {
+        MFnDependencyNode fnDependencyNode(dagPath.node(), &stat);
+        CheckErrorReturn(stat, "bindMesh: could not create dependency node function.");
+
+        MPlug pntsPlug = fnDependencyNode.findPlug("pnts", false, &stat);
+        CheckErrorReturn(stat, "bindMesh: could not find plug.");
+
+        const unsigned int numElm = pntsPlug.numElements(&stat);
+        CheckErrorReturn(stat, "bindMesh: could not get num elements.");
+
+        binding.tweaks.assign(numElm * 3, 0.0f);
+        for (unsigned int e = 0; e < numElm; ++e) {
+            MPlug pntPlug = pntsPlug.elementByPhysicalIndex(e, &stat);
+            CheckErrorReturn(stat, "bindMesh: could not get element plug.");
+
+            const unsigned int numChildren = pntPlug.numChildren(&stat);
+            CheckErrorReturn(stat, "bindMesh: could not get num children.");
+
+            for (unsigned int c = 0; c < numChildren && c < 3; ++c) {
+                MPlug childPlug = pntPlug.child(c, &stat);
+                CheckErrorReturn(stat, "bindMesh: could not get child plug.");
+
+                binding.tweaks[e * 3 + c] = childPlug.asFloat(&stat);
+                CheckErrorReturn(stat, "bindMesh: could not get tweak value.");
+            }
+        }
+        view.tweaks = binding.tweaks.data();
+        view.numTweaks = numElm;
+    }
+
+    if (needNormals) {
+        const int numNormals = fnMesh.numNormals(&stat);
+        CheckErrorReturn(stat, "bindMesh: could not get num normals.");
+
+        binding.normalLocked.resize(numNormals);
+        for (int n = 0; n < numNormals; ++n) {
+            binding.normalLocked[n] = fnMesh.isNormalLocked(n, &stat) ? 1 : 0;
+            CheckErrorReturn(stat, "bindMesh: could not get normal locked.");
+        }
+        view.normalLocked = binding.normalLocked.data();
+        view.numNormals = static_cast<unsigned int>(numNormals);
+    }
+
+    if (binding.uvSets.size() < uvSets.length()) {
+        binding.uvSets.resize(uvSets.length());
+    }
+    view.uvSets.resize(uvSets.length());
+    for (unsigned int s = 0; s < uvSets.length(); ++s) {
+        const MString& uvSetName = uvSets[s];
+        UVSetBinding& uvSet = binding.uvSets[s];
+
+        stat = fnMesh.getUVs(uvSet.u, uvSet.v, &uvSetName);
+        CheckErrorReturn(stat, "bindMesh: could not get uvs.");
+
+        stat = fnMesh.getAssignedUVs(uvSet.uvCounts, uvSet.uvIds, &uvSetName);
+        CheckErrorReturn(stat, "bindMesh: could not get assigned uvs.");
+
+        UVSetView& uvSetView = view.uvSets[s];
+        uvSetView = UVSetView();
+        uvSetView.u = arrayData(uvSet.u);
+        uvSetView.v = arrayData(uvSet.v);
+        uvSetView.numUVs = uvSet.u.length();
+        uvSetView.uvCounts = arrayData(uvSet.uvCounts);
+        uvSetView.uvIds = arrayData(uvSet.uvIds);
+        uvSetView.numUVIds = uvSet.uvIds.length();
+
+        if (needShells && labelShells && numPolygons > 0) {
+            uvSet.numShells = computeUVShellIds(view, uvSetView, uvSet.shellParents, uvSet.shellIds);
+#ifdef _DEBUG
+            validateUVShellIds(fnMesh, uvSetName, uvSet.shellIds, uvSet.numShells);
+#endif // _DEBUG
+
+            uvSetView.shellIds = uvSet.shellIds.empty() ? nullptr : uvSet.shellIds.data();
+            uvSetView.numShells = uvSet.numShells;
+        }
+    }
+
+    return stat;
+}
+
+typedef struct _meshCheckTdTag {
+    unsigned int    worker;
+    MeshCheckTask*  task;
+    MeshCheckHits*  hits;
+    MStatus         stat;
+
+    // work area, reused between meshes.
+    MeshBinding       binding;
+    MeshKernelScratch scratch;
+    MeshCheckResult   result;
+    CrossMeshScratch  crossScratch;
+    std::vector<CrossMeshHit> crossHits;
+} MeshCheckTdData;
+
+// Faces, or uvs for uv tiling over, of one mesh in one component.
+inline MStatus createMeshComponent(
+    const MeshCheckKind kind,
+    const int* ids,
+    const unsigned int numIds,
+    MObject& component
+) {
+    MStatus stat;
+    MFnSingleIndexedComponent fnComponent;
+    const MFn::Type type = kind == kMeshUVTilingOver ? MFn::kMeshMapComponent : MFn::kMeshPolygonComponent;
+    component = fnComponent.create(type, &stat);
+    if (stat != MStatus::kSuccess) {
+        return stat;
+    }
+
+    MIntArray elements(ids, numIds);
+    return fnComponent.addElements(elements);
+}
+
+// ==========================================================================
+// step 2
+
+// uv sets of dagPath the uv checks of task look at. Empty when there is
+// no uv check or the mesh is skipped.
+inline MStatus getCheckUVSets(
+    const MeshCheckTask* task,
+    const MDagPath& dagPath,
+    MFnMesh& fnMesh,
+    const int numPolygons,
+    MStringArray& uvSets
+) {
+    MStatus stat;
+    bool hasUVCheck = false;
+    for (const auto& kind : task->checks) {
+        hasUVCheck |= isUVCheck(kind);
+    }
+
+    uvSets.clear();
+    if (hasUVCheck && numPolygons == 0) {
+        // If this mesh don't have any face, skip it.
+        MGlobal::displayWarning(dagPath.partialPathName() + " is zero polygon. skip.");
+    }
+    else if (hasUVCheck) {
+        MStringArray uvSetNames;
+        stat = fnMesh.getUVSetNames(uvSetNames);
+        CheckErrorReturn(stat, "getCheckUVSets: could not get uv set names.");
+
+        if (task->allUVSet) {
+            uvSets = uvSetNames;
+        }
+        else if (uvSetNames.indexOf(task->uvSet) == -1) {
+            // Skip if this mesh don't have the specify uvSet wanted to.
+            MGlobal::displayWarning(dagPath.partialPathName() + " has't the " + task->uvSet + " uvSet. skip.");
+        }
+        else {
+            uvSets.append(task->uvSet);
+        }
+    }
+    return stat;
+}
+
+inline void addMeshHits(
+    const unsigned int index,
+    const std::vector<MeshCheckKind>& checks,
+    const MeshCheckResult& result,
+    MeshCheckHits& hits
+) {
+    for (const auto& kind : checks) {
+        if (!result.invalid[kind]) {
+            continue;
+        }
+
+        if (!result.faces[kind].empty()) {
+            const auto& faces = result.faces[kind];
+            hits.meshes[kind].insert(hits.meshes[kind].end(), faces.size(), index);
+            hits.components[kind].insert(hits.components[kind].end(), faces.begin(), faces.end());
+        }
+        else {
+            hits.meshes[kind].push_back(index);
+            hits.components[kind].push_back(-1);
+        }
+    }
+
+    const auto& groups = result.doubleFaceGroups;
+    for (size_t g = 0; g < groups.size(); g += 1 + groups[g]) {
+        hits.doubleFaceGroups.push_back(static_cast<int>(index));
+        hits.doubleFaceGroups.insert(hits.doubleFaceGroups.end(), groups.begin() + g, groups.begin() + g + 1 + groups[g]);
+    }
+
+    for (const auto& report : result.udimReports) {
+        hits.udimMeshes.push_back(index);
+        hits.udimReports.push_back(report);
+    }
+}
+
+// Bind the data checks need of the mesh at index for the kernels, only
+// uv set uvSet of it when uvSet is not -1. uvSetIndices gets the uv sets
+// of binding.view to check. A split mesh leaves its uv shells to
+// runMeshKernelsSplit.
+inline MStatus prepareMesh(
+    const MeshCheckTask* task,
+    const unsigned int index,
+    const bool split,
+    const int uvSet,
+    const std::vector<MeshCheckKind>& checks,
+    MeshBinding& binding,
+    std::vector<unsigned int>& uvSetIndices
+) {
+    MStatus stat;
+    const MDagPath& dagPath = task->meshArray[index];
+
+    MFnMesh fnMesh(dagPath, &stat);
+    CheckErrorReturn(stat, "prepareMesh: could not create MFnMesh.");
+
+    const int numPolygons = fnMesh.numPolygons(&stat);
+    CheckErrorReturn(stat, "prepareMesh: could not get num polygons.");
+
+    MStringArray uvSets;
+    stat = getCheckUVSets(task, dagPath, fnMesh, numPolygons, uvSets);
+    CheckErrorReturn(stat, "prepareMesh: could not get uv sets.");
+
+    if (uvSet >= 0) {
+        const MStringArray allUVSets = uvSets;
+        uvSets.clear();
+        if (static_cast<unsigned int>(uvSet) < allUVSets.length()) {
+            uvSets.append(allUVSets[uvSet]);
+        }
+    }
+
+    uvSetIndices.resize(uvSets.length());
+    for (unsigned int s = 0; s < uvSets.length(); ++s) {
+        uvSetIndices[s] = s;
+    }
+
+    stat = bindMesh(dagPath, fnMesh, numPolygons, checks, uvSets, !split, binding);
+    CheckErrorReturn(stat, "prepareMesh: could not bind mesh.");
+    return stat;
+}
+
+// Search the mesh at index, bound in view, against the other meshes in
+// world space, once for every instance path of it. The table keeps the
+// raw points of view, valid while the command runs, and a copy of its
+// faces, which the binding reuses. The hits go to the double face hits,
+// for this mesh and for the other meshes.
+inline MStatus checkCrossMesh(
+    MeshCheckTask* task,
+    const unsigned int index,
+    const MeshView& view,
+    CrossMeshScratch& scratch,
+    std::vector<CrossMeshHit>& crossHits,
+    MeshCheckHits& hits
+) {
+    MStatus stat;
+    const std::vector<MDagPath>& instancePaths = task->instancePaths[index];
+    const MeshView kept = task->crossMeshFaces[index].keep(view);
+    crossHits.clear();
+    for (size_t p = 0; p <= instancePaths.size(); ++p) {
+        const MDagPath& dagPath = p == 0 ? task->meshArray[index] : instancePaths[p - 1];
+        const MMatrix matrix = dagPath.inclusiveMatrix(&stat);
+        CheckErrorReturn(stat, "checkCrossMesh: could not get inclusive matrix.");
+
+        double m[4][4];
+        matrix.get(m);
+        task->crossMeshTable.search(kept, &m[0][0], index, scratch, crossHits);
+    }
+
+    for (const auto& hit : crossHits) {
+        hits.meshes[kMeshDoubleFace].push_back(hit.mesh);
+        hits.components[kMeshDoubleFace].push_back(hit.face);
+    }
+    return stat;
+}
+
+// Check scheduled item, a mesh or one uv set of it.
+inline MStatus checkMesh(
+    MeshCheckTdData* td,
+    const unsigned int item
+) {
+    MeshCheckTask* task = td->task;
+    const auto start = Profiler::now();
+    const unsigned int index = task->scheduledMeshes[item];
+    const int uvSet = task->scheduledUVSets[item];
+    const std::vector<MeshCheckKind>& checks = uvSet > 0 ? task->uvChecks : task->checks;
+
+    std::vector<unsigned int> uvSetIndices;
+    MStatus stat = prepareMesh(task, index, false, uvSet, checks, td->binding, uvSetIndices);
+    CheckErrorReturn(stat, "checkMesh: could not prepare mesh.");
+
+    runMeshKernels(td->binding.view, checks, uvSetIndices, task->kernelOptions, td->scratch, td->result);
+    if (uvSet >= 0) {
+        // the view has this uv set only.
+        for (auto& report : td->result.udimReports) {
+            report.uvSet = static_cast<unsigned int>(uvSet);
+        }
+    }
+    addMeshHits(index, checks, td->result, *td->hits);
+
+    if (uvSet <= 0 && hasCrossMeshCheck(task)) {
+        stat = checkCrossMesh(task, index, td->binding.view, td->crossScratch, td->crossHits, *td->hits);
+        CheckErrorReturn(stat, "checkMesh: could not check cross mesh.");
+    }
+
+    if (task->profiler.enabled()) {
+        task->scheduledSec[item] = Profiler::seconds(start);
+    }
+    return stat;
+}
+
+// One task per worker. Meshes come from the shared scheduler until every
+// queue is empty or a mesh fails.
+inline MThreadRetVal searchMeshChecksTd(void* data) {
+    MeshCheckTdData* td = (MeshCheckTdData*)data;
+
+    td->task->scheduler.work(td->worker, [&](unsigned int, unsigned int item) {
+        td->stat = checkMesh(td, item);
+        return td->stat == MStatus::kSuccess;
+    });
+
+    return (MThreadRetVal)0;
+}
+
+inline void searchMeshChecks(void* data, MThreadRootTask* root) {
+    MeshCheckTask* task = (MeshCheckTask*)data;
+
+    unsigned int size = std::max(1u, std::thread::hardware_concurrency());
+    if (task->scheduledMeshes.size() < size) {
+        size = static_cast<unsigned int>(task->scheduledMeshes.size());
+    }
+#ifdef _DEBUG
+    cerr << "workers = " << size << ".\n";
+#endif // _DEBUG
+
+    task->scheduler.reset(task->meshCosts, size);
+    task->scheduledSec.assign(task->profiler.enabled() ? task->scheduledMeshes.size() : 0, 0.0);
+    const size_t firstHits = task->hits.size();
+    task->hits.resize(firstHits + size);
+
+    std::vector<MeshCheckTdData> threadData(size);
+    for (unsigned int i = 0; i < size; ++i) {
+        threadData[i].worker = i;
+        threadData[i].task = task;
+        threadData[i].hits = &task->hits[firstHits + i];
+        threadData[i].stat = MStatus::kSuccess;
+
+        MThreadPool::createTask(searchMeshChecksTd, (void*)&threadData[i], root);
+    }
+
+    const auto start = WorkScheduler::Clock::now();
+    MThreadPool::executeAndJoin(root);
+    task->scheduler.setWallTime(
+        std::chrono::duration<double>(WorkScheduler::Clock::now() - start).count());
+
+    for (unsigned int i = 0; i < size; ++i) {
+        task->stat = threadData[i].stat;
+        CheckErrorBreak(task->stat, "searchMeshChecks: thread error");
+    }
+
+    // the time of a mesh is the sum of its uv sets.
+    std::vector<double> meshSec(task->meshArray.size(), 0.0);
+    for (size_t item = 0; item < task->scheduledSec.size(); ++item) {
+        meshSec[task->scheduledMeshes[item]] += task->scheduledSec[item];
+    }
+    for (size_t item = 0; item < task->scheduledSec.size(); ++item) {
+        const unsigned int index = task->scheduledMeshes[item];
+        task->profiler.setItemTime(index, meshSec[index]);
+    }
+}
+
+// ==========================================================================
+// step 3, meshes with at least splitFaces faces.
+
+// Large meshes are bound one by one on the main thread and their faces are
+// checked in parallel face ranges.
+inline MStatus searchSplitMeshes(MeshCheckTask& task) {
+    MStatus stat;
+    const unsigned int numRanges = std::max(1u, std::thread::hardware_concurrency()) * 4;
+
+    MeshBinding binding;
+    MeshKernelScratch scratch;
+    MeshSplitScratch split;
+    MeshCheckResult result;
+    CrossMeshScratch crossScratch;
+    std::vector<CrossMeshHit> crossHits;
+    std::vector<unsigned int> uvSetIndices;
+    task.hits.emplace_back();
+    MeshCheckHits& hits = task.hits.back();
+    for (const auto& index : task.splitMeshes) {
+        const auto start = Profiler::now();
+
+        stat = prepareMesh(&task, index, true, -1, task.checks, binding, uvSetIndices);
+        CheckErrorReturn(stat, "searchSplitMeshes: could not prepare mesh.");
+
+        runMeshKernelsSplit(binding.view, task.checks, uvSetIndices, numRanges,
+            task.kernelOptions, MThreadPoolFor(), scratch, split, result);
+        addMeshHits(index, task.checks, result, hits);
+
+        if (hasCrossMeshCheck(&task)) {
+            stat = checkCrossMesh(&task, index, binding.view, crossScratch, crossHits, hits);
+            CheckErrorReturn(stat, "searchSplitMeshes: could not check cross mesh.");
+        }
+
+        task.profiler.setItemTime(index, Profiler::seconds(start));
+    }
+    return stat;
+}
+
+// ==========================================================================
+// step 4, on the main thread after every worker is done. One selection
+// list entry per mesh and check, all its faces in one component, in
+// meshArray order whatever worker found them. With expandInstances the
+// entry is repeated for every other instance path of the mesh.
+typedef struct _meshHitRunTag {
+    unsigned int  mesh;
+    const int*    components;
+    unsigned int  count;
+} MeshHitRun;
+
+// The hits of kind grouped by mesh, sorted by mesh index.
+inline void collectHitRuns(
+    const MeshCheckTask& task,
+    const MeshCheckKind kind,
+    std::vector<MeshHitRun>& runs // out
+) {
+    runs.clear();
+    for (const auto& hits : task.hits) {
+        const auto& meshes = hits.meshes[kind];
+        size_t begin = 0;
+        while (begin < meshes.size()) {
+            size_t end = begin + 1;
+            while (end < meshes.size() && meshes[end] == meshes[begin]) {
+                ++end;
+            }
+            MeshHitRun run;
+            run.mesh = meshes[begin];
+            run.components = hits.components[kind].data() + begin;
+            run.count = static_cast<unsigned int>(end - begin);
+            runs.push_back(run);
+            begin = end;
+        }
+    }
+    std::sort(runs.begin(), runs.end(), [](const MeshHitRun& a, const MeshHitRun& b) {
+        return a.mesh < b.mesh;
+    });
+}
+
+inline MStatus buildInvalidLists(MeshCheckTask& task) {
+    MStatus stat;
+    std::vector<MeshHitRun> runs;
+    std::vector<int> merged;
+    for (const auto& kind : task.checks) {
+        collectHitRuns(task, kind, runs);
+
+        MSelectionList& invalidList = task.invalidLists[kind];
+        for (size_t r = 0; r < runs.size();) {
+            MeshHitRun run = runs[r];
+            size_t next = r + 1;
+            while (next < runs.size() && runs[next].mesh == run.mesh) {
+                ++next;
+            }
+            if (task.crossMesh || next > r + 1) {
+                // several runs, from the uv sets of a mesh or the cross
+                // mesh search, which can also repeat faces.
+                merged.clear();
+                for (size_t i = r; i < next; ++i) {
+                    merged.insert(merged.end(), runs[i].components, runs[i].components + runs[i].count);
+                }
+                sortUnique(merged);
+                run.components = merged.data();
+                run.count = static_cast<unsigned int>(merged.size());
+            }
+            r = next;
+
+            MObject component = MObject::kNullObj;
+            if (run.components[0] >= 0) {
+                stat = createMeshComponent(kind, run.components, run.count, component);
+                CheckErrorReturn(stat, "buildInvalidLists: could not create component.");
+            }
+
+            stat = invalidList.add(task.meshArray[run.mesh], component);
+            CheckErrorReturn(stat, "buildInvalidLists: could not add invalid list.");
+
+            if (!task.expandInstances) {
+                continue;
+            }
+            for (const auto& instancePath : task.instancePaths[run.mesh]) {
+                stat = invalidList.add(instancePath, component);
+                CheckErrorReturn(stat, "buildInvalidLists: could not add instance to invalid list.");
+            }
+        }
+    }
+    return stat;
+}
+
+// task.doubleFaceGroups from the hits. With expandInstances every group
+// is repeated for the other instance paths of its mesh.
+inline void collectDoubleFaceGroups(MeshCheckTask& task) {
+    task.doubleFaceGroups.clear();
+    if (!task.kernelOptions.doubleFaceGroups) {
+        return;
+    }
+
+    // count, face ids... of a group. The groups of a mesh are in one hits
+    // buffer, the stable sort keeps their order.
+    struct GroupRef
+    {
+        unsigned int mesh;
+        const int* group;
+    };
+    std::vector<GroupRef> refs;
+    for (const auto& hits : task.hits) {
+        const auto& groups = hits.doubleFaceGroups;
+        for (size_t g = 0; g < groups.size(); g += 2 + groups[g + 1]) {
+            refs.push_back({ static_cast<unsigned int>(groups[g]), &groups[g + 1] });
+        }
+    }
+    std::stable_sort(refs.begin(), refs.end(), [](const GroupRef& a, const GroupRef& b) {
+        return a.mesh < b.mesh;
+    });
+
+    for (const auto& ref : refs) {
+        const size_t numPaths = task.expandInstances ? 1 + task.instancePaths[ref.mesh].size() : 1;
+        for (size_t p = 0; p < numPaths; ++p) {
+            const MDagPath& dagPath = p == 0 ? task.meshArray[ref.mesh] : task.instancePaths[ref.mesh][p - 1];
+            const MString name = dagPath.partialPathName();
+            MString line;
+            for (int f = 0; f < ref.group[0]; ++f) {
+                if (f > 0) {
+                    line += " ";
+                }
+                line += name;
+                line += ".f[";
+                line += ref.group[1 + f];
+                line += "]";
+            }
+            task.doubleFaceGroups.append(line);
+        }
+    }
+}
+
+// task.udims and task.udimShells from the hits, in mesh order.
+inline MStatus collectUDIMReports(MeshCheckTask& task) {
+    MStatus stat;
+    task.udims.clear();
+    task.udimShells.clear();
+    if (!task.kernelOptions.udimReport) {
+        return stat;
+    }
+
+    struct ReportRef
+    {
+        unsigned int mesh;
+        const UDIMReport* report;
+    };
+    std::vector<ReportRef> refs;
+    for (const auto& hits : task.hits) {
+        for (size_t i = 0; i < hits.udimReports.size(); ++i) {
+            refs.push_back({ hits.udimMeshes[i], &hits.udimReports[i] });
+        }
+    }
+    // the uv sets of a mesh can come from several workers.
+    std::sort(refs.begin(), refs.end(), [](const ReportRef& a, const ReportRef& b) {
+        return a.mesh != b.mesh ? a.mesh < b.mesh : a.report->uvSet < b.report->uvSet;
+    });
+
+    MStringArray uvSets;
+    std::vector<int> udims;
+    for (size_t r = 0; r < refs.size(); ++r) {
+        const MDagPath& dagPath = task.meshArray[refs[r].mesh];
+        if (r == 0 || refs[r].mesh != refs[r - 1].mesh) {
+            MFnMesh fnMesh(dagPath, &stat);
+            CheckErrorReturn(stat, "collectUDIMReports: could not create MFnMesh.");
+
+            const int numPolygons = fnMesh.numPolygons(&stat);
+            CheckErrorReturn(stat, "collectUDIMReports: could not get num polygons.");
+
+            stat = getCheckUVSets(&task, dagPath, fnMesh, numPolygons, uvSets);
+            CheckErrorReturn(stat, "collectUDIMReports: could not get uv sets.");
+        }
+
+        const UDIMReport& report = *refs[r].report;
+        const MString prefix = dagPath.partialPathName() + " " + uvSets[report.uvSet];
+
+        MString line = prefix;
+        getUDIMs(report, udims);
+        for (const auto& udim : udims) {
+            line += " ";
+            line += udim;
+        }
+        if (report.outside) {
+            line += " outside";
+        }
+        task.udims.append(line);
+
+        const std::vector<int>& tiles = report.shellTiles;
+        for (unsigned int shell = 0; shell * 4 < tiles.size(); ++shell) {
+            MString shellLine = prefix;
+            shellLine += " ";
+            shellLine += shell;
+            for (unsigned int i = 0; i < 4; ++i) {
+                shellLine += " ";
+                shellLine += tiles[shell * 4 + i];
+            }
+            task.udimShells.append(shellLine);
+        }
+    }
+    return stat;
+}
+
+// Keep the results of the meshes checked in this run.
+inline MStatus storeMeshCheckCache(MeshCheckTask& task) {
+    MStatus stat;
+    MeshCheckCache& cache = meshCheckCache();
+
+    std::vector<MeshCheckCacheEntry*> entries(task.meshArray.size(), nullptr);
+    for (unsigned int i = 0; i < task.meshArray.size(); ++i) {
+        if (task.cachedMeshes[i]) {
+            continue;
+        }
+
+        MObject node = task.meshArray[i].node();
+        MeshCheckCacheEntry* entry = cache.insert(node, stat);
+        CheckErrorReturn(stat, "storeMeshCheckCache: could not add cache entry.");
+
+        for (const auto& kind : task.checks) {
+            entry->keys[kind] = meshCheckCacheKey(task, kind);
+            entry->invalid[kind] = false;
+            entry->faces[kind].clear();
+        }
+        entries[i] = entry;
+    }
+
+    std::vector<MeshHitRun> runs;
+    for (const auto& kind : task.checks) {
+        collectHitRuns(task, kind, runs);
+        for (const auto& run : runs) {
+            MeshCheckCacheEntry* entry = entries[run.mesh];
+            if (entry == nullptr) {
+                continue;
+            }
+            entry->invalid[kind] = true;
+            if (run.components[0] >= 0) {
+                entry->faces[kind].insert(entry->faces[kind].end(), run.components, run.components + run.count);
+            }
+        }
+    }
+
+    // the uv sets of a mesh come in several runs.
+    for (auto& entry : entries) {
+        if (entry == nullptr) {
+            continue;
+        }
+        for (const auto& kind : task.checks) {
+            sortUnique(entry->faces[kind]);
+        }
+    }
+    return stat;
+}
+
+// Collect meshes once and run every check in task.checks on them.
+inline MStatus runMeshChecks(MeshCheckTask& task) {
+    MStatus stat = MStatus::kSuccess;
+    Profiler& profiler = task.profiler;
+
+    // ======================================================================
+    // step 1
+    auto start = Profiler::now();
+    if (task.flushCache) {
+        const unsigned int flushed = meshCheckCache().clear();
+        if (task.cacheInfo) {
+            char line[128];
+            snprintf(line, sizeof(line), "cache: flushed %u meshes.", flushed);
+            MGlobal::displayInfo(line);
+        }
+    }
+
+    stat = getAllMesh(task);
+    CheckDisplayError(stat, "runMeshChecks: getAllMesh.");
+    profiler.addStage("collect", start);
+
+    if (task.useCache) {
+        start = Profiler::now();
+        lookupMeshCheckCache(task);
+        profiler.addStage("cacheLookup", start);
+    }
+
+    start = Profiler::now();
+    stat = getMeshCosts(task);
+    CheckDisplayError(stat, "runMeshChecks: getMeshCosts.");
+    profiler.addStage("estimate", start);
+
+    // ======================================================================
+    // check mesh size.
+    if (task.meshArray.size() == 0 || task.checks.size() == 0) {
+        return stat;
+    }
+    profiler.resetItems(task.meshArray.size());
+
+    // ======================================================================
+    // Thread init.
+    start = Profiler::now();
+    stat = MThreadPool::init();
+    CheckDisplayError(stat, "runMeshChecks: could not create threadpool.");
+    profiler.addStage("poolInit", start);
+
+    // ======================================================================
+    // step 2
+    start = Profiler::now();
+    if (!task.scheduledMeshes.empty()) {
+        MThreadPool::newParallelRegion(searchMeshChecks, (void*)&task);
+        CheckDisplayErrorRelease(task.stat, "runMeshChecks: searchMeshChecks error.");
+    }
+    profiler.addStage("parallelRegion", start);
+
+    // ======================================================================
+    // step 3
+    start = Profiler::now();
+    stat = searchSplitMeshes(task);
+    CheckDisplayErrorRelease(stat, "runMeshChecks: searchSplitMeshes error.");
+    profiler.addStage("splitMeshes", start);
+
+    MThreadPool::release();
+
+    // ======================================================================
+    // step 4
+    start = Profiler::now();
+    stat = buildInvalidLists(task);
+    CheckDisplayError(stat, "runMeshChecks: buildInvalidLists error.");
+    collectDoubleFaceGroups(task);
+    stat = collectUDIMReports(task);
+    CheckDisplayError(stat, "runMeshChecks: collectUDIMReports error.");
+    profiler.addStage("buildLists", start);
+
+    if (task.useCache) {
+        start = Profiler::now();
+        stat = storeMeshCheckCache(task);
+        CheckDisplayError(stat, "runMeshChecks: storeMeshCheckCache error.");
+        profiler.addStage("cacheStore", start);
+    }
+
+    if (task.cacheInfo) {
+        char line[128];
+        snprintf(line, sizeof(line), "cache: %u meshes cached, %u reused, %u checked.",
+            meshCheckCache().size(), task.cacheHits,
+            static_cast<unsigned int>(task.meshArray.size()) - task.cacheHits);
+        MGlobal::displayInfo(line);
+    }
+
+    if (task.workerStats) {
+        printWorkerStats(task.scheduler, [](const char* line) {
+            MGlobal::displayInfo(line);
+        });
+    }
+
+#ifdef _DEBUG
+    for (const auto& stage : profiler.stages()) {
+        cerr << stage.name << " = " << stage.sec << "sec.\n";
+    }
+#endif // _DEBUG
+
+    return stat;
+}
+
+// Build the -profile result: stages, worker stats, the slowest meshes,
+// the selection strings of every check and the cache counts with -cache.
+// Adds the "results" stage.
+inline MStatus getProfileResult(
+    MeshCheckTask& task,
+    MString& profile // out
+) {
+    MStatus stat = MStatus::kSuccess;
+    const auto start = Profiler::now();
+
+    std::string results = ",\"results\":{";
+    MStringArray selectionStrings;
+    for (size_t k = 0; k < task.checks.size(); ++k) {
+        const MeshCheckKind kind = task.checks[k];
+        if (k > 0) {
+            results += ",";
+        }
+        appendJsonString(results, meshCheckName(kind));
+        results += ":[";
+
+        selectionStrings.clear();
+        stat = task.invalidLists[kind].getSelectionStrings(selectionStrings);
+        CheckDisplayError(stat, "getProfileResult: invalid.getSelectionStrings is failed.");
+
+        for (unsigned int i = 0; i < selectionStrings.length(); ++i) {
+            if (i > 0) {
+                results += ",";
+            }
+            appendJsonString(results, selectionStrings[i].asChar());
+        }
+        results += "]";
+    }
+    results += "}";
+
+    if (task.useCache) {
+        results += ",\"cache\":{\"entries\":";
+        appendJsonNumber(results, meshCheckCache().size());
+        results += ",\"reused\":";
+        appendJsonNumber(results, task.cacheHits);
+        results += ",\"checked\":";
+        appendJsonNumber(results, static_cast<double>(task.meshArray.size() - task.cacheHits));
+        results += "}";
+    }
+    task.profiler.addStage("results", start);
+
+    std::string json;
+    writeProfileJson(json, task.profiler, task.scheduler, [&](unsigned int i) {
+        return std::string(task.meshArray[i].partialPathName().asChar());
+    }, results);
+
+    profile = json.c_str();
+    return stat;
+}
@@ -0,0 +1,189 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Results of mesh checks kept between command invocations (-cache).
+//
+// Entries are per mesh shape node. Every entry has a dirty plug callback on
+// its node, a change to the geometry, uvs, normals or pnts of the mesh
+// marks the entry dirty and its results are dropped at the next lookup.
+// A result is only reused when it was computed with the same settings
+// (the key of the check, see meshCheckCacheKey in meshCheck.h).
+//
+// The cache lives in the plugin, every plugin has its own. Callbacks point
+// into the plugin, so uninitializePlugin must call meshCheckCache().clear().
+
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <maya/MCallbackIdArray.h>
+#include <maya/MMessage.h>
+#include <maya/MNodeMessage.h>
+#include <maya/MObject.h>
+#include <maya/MObjectHandle.h>
+#include <maya/MPlug.h>
+#include <maya/MString.h>
+
+#include "meshKernels.h"
+
+typedef struct _meshCheckCacheEntryTag {
+    MObjectHandle handle;
+    MCallbackId   callback;
+    bool          dirty;
+
+    // empty key: no result for the check.
+    std::string      keys[kMeshCheckCount];
+    bool             invalid[kMeshCheckCount];
+    std::vector<int> faces[kMeshCheckCount];
+
+    void clearResults() {
+        for (int k = 0; k < kMeshCheckCount; ++k) {
+            keys[k].clear();
+            invalid[k] = false;
+            faces[k].clear();
+        }
+    }
+} MeshCheckCacheEntry;
+
+// Attributes of a mesh shape the checks read. Anything else, like display
+// or shading changes, keeps the entry clean.
+inline bool isMeshCheckPlug(const MPlug& plug) {
+    static const char* names[] = {
+        "inMesh", "outMesh", "cachedInMesh", "pnts",
+        "uvPnt", "uvSet", "currentUVSet", "normals",
+        "vrts", "edge", "face",
+    };
+
+    MPlug root = plug;
+    for (;;) {
+        if (root.isChild()) {
+            root = root.parent();
+        }
+        else if (root.isElement()) {
+            root = root.array();
+        }
+        else {
+            break;
+        }
+    }
+
+    const MString name = root.partialName(false, false, false, false, false, true);
+    for (const auto& n : names) {
+        if (std::strcmp(name.asChar(), n) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+class MeshCheckCache
+{
+public:
+    // The clean entry of node, nullptr when there is none. A dirty entry
+    // loses its results and is returned clean.
+    MeshCheckCacheEntry* find(const MObject& node) {
+        const MObjectHandle handle(node);
+        auto it = _entries.find(handle.hashCode());
+        if (it == _entries.end() || !(it->second.handle == handle) || !it->second.handle.isValid()) {
+            return nullptr;
+        }
+
+        MeshCheckCacheEntry& entry = it->second;
+        if (entry.dirty) {
+            entry.clearResults();
+            entry.dirty = false;
+        }
+        return &entry;
+    }
+
+    // The entry of node, created with its callback when there is none.
+    MeshCheckCacheEntry* insert(MObject& node, MStatus& stat) {
+        stat = MStatus::kSuccess;
+        MeshCheckCacheEntry* found = find(node);
+        if (found != nullptr) {
+            return found;
+        }
+
+        // replaces the entry of a deleted node or of another node with the
+        // same hash code.
+        const MObjectHandle handle(node);
+        auto it = _entries.find(handle.hashCode());
+        if (it != _entries.end()) {
+            MMessage::removeCallback(it->second.callback);
+        }
+        MeshCheckCacheEntry& entry = _entries[handle.hashCode()];
+        entry.handle = handle;
+        entry.dirty = false;
+        entry.clearResults();
+        entry.callback = MNodeMessage::addNodeDirtyPlugCallback(node, dirtyPlugCallback, &entry, &stat);
+        if (stat != MStatus::kSuccess) {
+            _entries.erase(handle.hashCode());
+            return nullptr;
+        }
+        return &entry;
+    }
+
+    // Drop the entries of deleted nodes.
+    void prune() {
+        for (auto it = _entries.begin(); it != _entries.end();) {
+            if (it->second.handle.isValid()) {
+                ++it;
+                continue;
+            }
+            MMessage::removeCallback(it->second.callback);
+            it = _entries.erase(it);
+        }
+    }
+
+    // Remove every entry and callback, returns the number of entries.
+    unsigned int clear() {
+        const unsigned int count = static_cast<unsigned int>(_entries.size());
+        for (auto& e : _entries) {
+            MMessage::removeCallback(e.second.callback);
+        }
+        _entries.clear();
+        return count;
+    }
+
+    unsigned int size() const {
+        return static_cast<unsigned int>(_entries.size());
+    }
+
+private:
+    static void dirtyPlugCallback(MObject&, MPlug& plug, void* clientData) {
+        MeshCheckCacheEntry* entry = static_cast<MeshCheckCacheEntry*>(clientData);
+        if (!entry->dirty && isMeshCheckPlug(plug)) {
+            entry->dirty = true;
+        }
+    }
+
+    // keyed by MObjectHandle::hashCode, values do not move on rehash.
+    std::unordered_map<unsigned int, MeshCheckCacheEntry> _entries;
+};
+
+inline MeshCheckCache& meshCheckCache() {
+    static MeshCheckCache cache;
+    return cache;
+}
@@ -0,0 +1,1345 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Mesh check kernels on a MeshView.
+//
+// These are the detection bodies of the checkMesh* plugins. They only see
+// flat arrays, so the same code runs inside Maya (common/meshCheck.h) and
+// in the headless modelcheck CLI (cli/modelcheck.cpp).
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#if !defined(MODELCHECK_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UV_TILE_SSE2 1
+#endif
+#endif
+
+#include "meshView.h"
+#include "toleranceGrid.h"
+
+enum MeshCheckKind
+{
+    kMeshDoubleFace = 0,
+    kMeshFreeze,
+    kMeshUVFlip,
+    kMeshUVNegative,
+    kMeshUVFull,
+    kMeshUVTilingOver,
+    kMeshNormalLock,
+    kMeshFace0Count,
+    kMeshCheckCount
+};
+
+namespace
+{
+    // command names, also used to tag modelCheck results.
+    const char *meshCheckNames[kMeshCheckCount] = {
+        "checkMeshDoubleFace",
+        "checkMeshFreeze",
+        "checkMeshUVFlip",
+        "checkMeshUVNegative",
+        "checkMeshUVFull",
+        "checkMeshUVTilingOver",
+        "checkMeshNormalLock",
+        "checkMeshFace0Count",
+    };
+
+    // short names accepted by modelCheck -check.
+    const char *meshCheckShortNames[kMeshCheckCount] = {
+        "doubleFace",
+        "freeze",
+        "uvFlip",
+        "uvNegative",
+        "uvFull",
+        "uvTilingOver",
+        "normalLock",
+        "face0Count",
+    };
+};
+
+inline const char* meshCheckName(const MeshCheckKind kind) {
+    return meshCheckNames[kind];
+}
+
+inline bool findMeshCheck(const char* name, MeshCheckKind& kind) {
+    for (int k = 0; k < kMeshCheckCount; ++k) {
+        if (std::strcmp(name, meshCheckNames[k]) == 0 || std::strcmp(name, meshCheckShortNames[k]) == 0) {
+            kind = static_cast<MeshCheckKind>(k);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool isUVCheck(const MeshCheckKind kind) {
+    return kind == kMeshUVFlip
+        || kind == kMeshUVNegative
+        || kind == kMeshUVFull
+        || kind == kMeshUVTilingOver;
+}
+
+// whole mesh checks report the mesh itself, the others report faces.
+inline bool isFaceCheck(const MeshCheckKind kind) {
+    return kind == kMeshDoubleFace
+        || kind == kMeshUVFlip
+        || kind == kMeshUVNegative
+        || kind == kMeshUVFull;
+}
+
+// Open addressing table of face signature hashes for the double face
+// search. A slot keeps the face and the index of its first vertex in
+// faceConnects, the signature itself is only rebuilt when two hashes
+// match. Nothing is stored per vertex and nothing is allocated per face.
+struct FaceSignatureTable
+{
+    struct Slot
+    {
+        uint64_t     hash;
+        int          faceId; // -1: empty
+        unsigned int offset;
+    };
+
+    std::vector<Slot> slots;
+    size_t mask = 0;
+
+    // Empty the table for up to numFaces faces, keeping the storage.
+    void reset(const size_t numFaces) {
+        size_t capacity = 16;
+        while (capacity < numFaces * 2) {
+            capacity <<= 1;
+        }
+        Slot empty;
+        empty.hash = 0;
+        empty.faceId = -1;
+        empty.offset = 0;
+        slots.assign(capacity, empty);
+        mask = capacity - 1;
+    }
+};
+
+// Spatial hash grid for the double face search with a tolerance. A slot
+// maps a cell to the last face whose corner is in it, the earlier faces
+// of the cell are chained through MeshKernelScratch::cellNext.
+struct FaceCellTable
+{
+    struct Slot
+    {
+        int64_t x, y, z;
+        int     head; // -1: empty
+    };
+
+    std::vector<Slot> slots;
+    size_t mask = 0;
+
+    void reset(const size_t numFaces) {
+        size_t capacity = 16;
+        while (capacity < numFaces * 2) {
+            capacity <<= 1;
+        }
+        Slot empty;
+        empty.x = empty.y = empty.z = 0;
+        empty.head = -1;
+        slots.assign(capacity, empty);
+        mask = capacity - 1;
+    }
+};
+
+// Position of a face vertex in a signature.
+struct FaceVertexKey
+{
+    uint32_t x, y, z;
+
+    bool operator<(const FaceVertexKey& rhs) const {
+        return x != rhs.x ? x < rhs.x : (y != rhs.y ? y < rhs.y : z < rhs.z);
+    }
+    bool operator==(const FaceVertexKey& rhs) const {
+        return x == rhs.x && y == rhs.y && z == rhs.z;
+    }
+};
+
+// Per worker work area. Reused between meshes so the containers keep their
+// capacity.
+struct MeshKernelScratch
+{
+    // double face
+    FaceSignatureTable faceTable;
+    std::vector<int> faceIds[2];
+    std::vector<FaceVertexKey> faceKeys[2];
+    std::vector<uint64_t> facePairs;
+    std::vector<int> faceRoots;
+    // double face with a tolerance
+    FaceCellTable cellTable;
+    std::vector<int> cellNext;
+    std::vector<unsigned int> faceOffsets;
+    std::vector<double> faceCorners;
+
+    // uv tiling over
+    std::vector<int> tileU;
+    std::vector<int> tileV;
+    // per shell min u, max u, min v, max v tile.
+    std::vector<int> shellTiles;
+    std::vector<int> shellIds;
+    std::vector<int> shellParents;
+};
+
+// Settings of the kernels.
+struct MeshKernelOptions
+{
+    MeshKernelOptions() : tolerance(0.0), doubleFaceGroups(false), udimReport(false), tilingOverUVs(false) {}
+
+    // double face: 0 compares exact positions. Otherwise two faces are
+    // double faces when every vertex of each is within tolerance of a
+    // vertex of the other.
+    double tolerance;
+    // double face: also fill MeshCheckResult::doubleFaceGroups.
+    bool doubleFaceGroups;
+    // uv tiling over: also fill MeshCheckResult::udimReports.
+    bool udimReport;
+    // uv tiling over: report the uvs of the shells over tiles in
+    // MeshCheckResult::faces, instead of the whole mesh.
+    bool tilingOverUVs;
+};
+
+// Rows of the UDIM grid, UDIMs 1001 to 10999.
+const int kUDIMRows = 1000;
+
+// Uv tiles of one uv set. Tile (u, v) is UDIM 1001 + u + 10 * v on the
+// grid of 10 tiles per row, 0 <= u < 10 and 0 <= v < kUDIMRows, and sets
+// bit u + 10 * v of tiles. Uvs off the grid set outside.
+struct UDIMReport
+{
+    UDIMReport() : uvSet(0), outside(false) {}
+
+    // index into MeshView::uvSets.
+    unsigned int uvSet;
+    std::vector<uint64_t> tiles;
+    bool outside;
+    // min u, max u, min v, max v tile per shell.
+    std::vector<int> shellTiles;
+};
+
+// The UDIMs set in report, ascending.
+inline void getUDIMs(const UDIMReport& report, std::vector<int>& udims) {
+    udims.clear();
+    for (unsigned int w = 0; w < report.tiles.size(); ++w) {
+        for (uint64_t bits = report.tiles[w]; bits != 0; bits &= bits - 1) {
+            unsigned int bit = 0;
+            while (!((bits >> bit) & 1)) {
+                ++bit;
+            }
+            udims.push_back(1001 + static_cast<int>(w * 64 + bit));
+        }
+    }
+}
+
+struct MeshCheckResult
+{
+    // whole mesh result.
+    bool invalid[kMeshCheckCount];
+    // face ids for face checks, sorted and unique. Uv ids for uv tiling
+    // over with MeshKernelOptions::tilingOverUVs.
+    std::vector<int> faces[kMeshCheckCount];
+    // with MeshKernelOptions::doubleFaceGroups, every set of faces that
+    // double each other as the number of faces then the face ids,
+    // ascending. Groups are in the order of their first face.
+    std::vector<int> doubleFaceGroups;
+    // with MeshKernelOptions::udimReport, one per checked uv set.
+    std::vector<UDIMReport> udimReports;
+
+    void clear() {
+        for (int k = 0; k < kMeshCheckCount; ++k) {
+            invalid[k] = false;
+            faces[k].clear();
+        }
+        doubleFaceGroups.clear();
+        udimReports.clear();
+    }
+};
+
+inline void sortUnique(std::vector<int>& values) {
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+}
+
+// ==========================================================================
+// kernels
+
+// A double face and the first face of its group, packed so that sorting
+// orders by group, then by face.
+inline uint64_t packFacePair(const int first, const int face) {
+    return ((uint64_t)(uint32_t)first << 32) | (uint32_t)face;
+}
+
+// Flat groups of MeshCheckResult::doubleFaceGroups from packed pairs.
+inline void buildFaceGroups(std::vector<uint64_t>& pairs, std::vector<int>& groups) {
+    std::sort(pairs.begin(), pairs.end());
+    size_t i = 0;
+    while (i < pairs.size()) {
+        const uint32_t first = static_cast<uint32_t>(pairs[i] >> 32);
+        size_t j = i;
+        while (j < pairs.size() && static_cast<uint32_t>(pairs[j] >> 32) == first) {
+            ++j;
+        }
+        groups.push_back(static_cast<int>(j - i + 1));
+        groups.push_back(static_cast<int>(first));
+        for (size_t k = i; k < j; ++k) {
+            groups.push_back(static_cast<int>(static_cast<uint32_t>(pairs[k])));
+        }
+        i = j;
+    }
+}
+
+inline uint64_t mixHash(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Bits of a coordinate, -0 and 0 are the same position.
+inline uint32_t floatKey(const float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits == 0x80000000u ? 0u : bits;
+}
+
+inline FaceVertexKey faceVertexKey(const MeshView& mesh, const int vertexId) {
+    const float* p = mesh.points + 3 * vertexId;
+    FaceVertexKey key;
+    key.x = floatKey(p[0]);
+    key.y = floatKey(p[1]);
+    key.z = floatKey(p[2]);
+    return key;
+}
+
+// Hash of the multiset of vertex positions of a face. The per vertex
+// hashes are summed, so the vertex order and the starting vertex do not
+// matter and nothing has to be sorted.
+inline uint64_t faceSignatureHash(const MeshView& mesh, const int* connect, const int count) {
+    uint64_t hash = mixHash(static_cast<uint64_t>(count));
+    for (int v = 0; v < count; ++v) {
+        const FaceVertexKey key = faceVertexKey(mesh, connect[v]);
+        hash += mixHash(mixHash(((uint64_t)key.x << 32) | key.y) ^ key.z);
+    }
+    return hash;
+}
+
+// Whether two faces with the same vertex count have the same signature:
+// the same sorted vertex ids (a topological duplicate), or else the same
+// sorted vertex positions (a geometric duplicate).
+inline bool sameFaceSignature(
+    const MeshView& mesh,
+    const int* connectA,
+    const int* connectB,
+    const int count,
+    MeshKernelScratch& scratch
+) {
+    std::vector<int>& idsA = scratch.faceIds[0];
+    std::vector<int>& idsB = scratch.faceIds[1];
+    idsA.assign(connectA, connectA + count);
+    idsB.assign(connectB, connectB + count);
+    std::sort(idsA.begin(), idsA.end());
+    std::sort(idsB.begin(), idsB.end());
+    if (idsA == idsB) {
+        return true;
+    }
+
+    std::vector<FaceVertexKey>& keysA = scratch.faceKeys[0];
+    std::vector<FaceVertexKey>& keysB = scratch.faceKeys[1];
+    keysA.resize(count);
+    keysB.resize(count);
+    for (int v = 0; v < count; ++v) {
+        keysA[v] = faceVertexKey(mesh, connectA[v]);
+        keysB[v] = faceVertexKey(mesh, connectB[v]);
+    }
+    std::sort(keysA.begin(), keysA.end());
+    std::sort(keysB.begin(), keysB.end());
+    return keysA == keysB;
+}
+
+// One face of searchDoubleFace. offset is the index of the first vertex of
+// the face in faceConnects and hash its faceSignatureHash. Faces must be
+// visited in ascending order for the result to match the serial search.
+// pairs, when not null, gets the packFacePair of every double face.
+inline void searchDoubleFaceStep(
+    const MeshView& mesh,
+    const int faceId,
+    const unsigned int offset,
+    const uint64_t hash,
+    MeshKernelScratch& scratch,
+    std::vector<int>& faces,
+    std::vector<uint64_t>* pairs
+) {
+    FaceSignatureTable& table = scratch.faceTable;
+    const int count = mesh.faceCounts[faceId];
+
+    size_t i = static_cast<size_t>(hash) & table.mask;
+    for (;; i = (i + 1) & table.mask) {
+        FaceSignatureTable::Slot& slot = table.slots[i];
+        if (slot.faceId < 0) {
+            slot.hash = hash;
+            slot.faceId = faceId;
+            slot.offset = offset;
+            return;
+        }
+
+        if (slot.hash == hash
+            && mesh.faceCounts[slot.faceId] == count
+            && sameFaceSignature(mesh, mesh.faceConnects + slot.offset, mesh.faceConnects + offset, count, scratch)) {
+            // the earlier face is reported. The slot keeps the first face
+            // of the signature, the first face of the group.
+            faces.push_back(slot.faceId);
+            if (pairs != nullptr) {
+                pairs->push_back(packFacePair(slot.faceId, faceId));
+            }
+            return;
+        }
+    }
+}
+
+// Two faces are double faces when they have the same vertices, or the
+// same vertex positions in any order. The earlier face is reported.
+inline void searchDoubleFace(
+    const MeshView& mesh,
+    MeshKernelScratch& scratch,
+    std::vector<int>& faces,
+    std::vector<uint64_t>* pairs
+) {
+    scratch.faceTable.reset(mesh.numFaces);
+
+    unsigned int offset = 0;
+    for (unsigned int faceId = 0; faceId < mesh.numFaces; ++faceId) {
+        const int count = mesh.faceCounts[faceId];
+        const uint64_t hash = faceSignatureHash(mesh, mesh.faceConnects + offset, count);
+        searchDoubleFaceStep(mesh, static_cast<int>(faceId), offset, hash, scratch, faces, pairs);
+        offset += count;
+    }
+}
+
+inline size_t cellHash(const int64_t x, const int64_t y, const int64_t z) {
+    return static_cast<size_t>(mixHash(mixHash(mixHash((uint64_t)x) ^ (uint64_t)y) ^ (uint64_t)z));
+}
+
+// Slot of cell (x, y, z), or of the empty slot where it would go.
+inline FaceCellTable::Slot& findCell(FaceCellTable& table, const int64_t x, const int64_t y, const int64_t z) {
+    size_t i = cellHash(x, y, z) & table.mask;
+    for (;; i = (i + 1) & table.mask) {
+        FaceCellTable::Slot& slot = table.slots[i];
+        if (slot.head < 0 || (slot.x == x && slot.y == y && slot.z == z)) {
+            return slot;
+        }
+    }
+}
+
+// Every vertex of face A is within sqrt(tolerance2) of a vertex of face B.
+inline bool faceVerticesWithin(
+    const MeshView& mesh,
+    const int* connectA,
+    const int* connectB,
+    const int count,
+    const double tolerance2
+) {
+    for (int a = 0; a < count; ++a) {
+        const float* pa = mesh.points + 3 * connectA[a];
+        bool near = false;
+        for (int b = 0; b < count && !near; ++b) {
+            const float* pb = mesh.points + 3 * connectB[b];
+            const double dx = (double)pa[0] - pb[0];
+            const double dy = (double)pa[1] - pb[1];
+            const double dz = (double)pa[2] - pb[2];
+            near = dx * dx + dy * dy + dz * dz <= tolerance2;
+        }
+        if (!near) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Offset into mesh.faceConnects and the lowest x, y and z of the vertices
+// of every face, in one pass over the flat arrays. A face without
+// vertices has its corner at the origin. The corner is a vertex coordinate,
+// so it is exact whatever the magnitude of the points. Returns the largest
+// absolute corner coordinate.
+inline double computeFaceCorners(
+    const MeshView& mesh,
+    std::vector<unsigned int>& faceOffsets, // out
+    std::vector<double>& faceCorners // out
+) {
+    const unsigned int numFaces = mesh.numFaces;
+    faceOffsets.resize(numFaces);
+    faceCorners.resize(numFaces * 3);
+
+    unsigned int offset = 0;
+    for (unsigned int faceId = 0; faceId < numFaces; ++faceId) {
+        faceOffsets[faceId] = offset;
+        offset += mesh.faceCounts[faceId];
+    }
+
+    const float* points = mesh.points;
+    const int* connects = mesh.faceConnects;
+    double* corners = faceCorners.data();
+    float largest = 0.0f;
+    for (unsigned int faceId = 0; faceId < numFaces; ++faceId) {
+        const int count = mesh.faceCounts[faceId];
+        const int* connect = connects + faceOffsets[faceId];
+        float corner[3] = { 0.0f, 0.0f, 0.0f };
+        for (int v = 0; v < count; ++v) {
+            const float* p = points + 3 * connect[v];
+            for (int a = 0; a < 3; ++a) {
+                corner[a] = v == 0 ? p[a] : std::min(corner[a], p[a]);
+            }
+        }
+        for (int a = 0; a < 3; ++a) {
+            corners[faceId * 3 + a] = corner[a];
+            largest = std::max(largest, std::fabs(corner[a]));
+        }
+    }
+    return largest;
+}
+
+// searchDoubleFace within tolerance. The lowest corners of the face
+// bounding boxes are snapped to a grid of cells twice the tolerance wide.
+// Every vertex of a near double face is within tolerance of a vertex of
+// the face and the other way around, so on each axis their lowest
+// coordinates are at most tolerance apart. Their centers are not: a face
+// with its vertices bunched on one side can match a face bunched on the
+// other. The corner of a near double face is in the same cell or in the
+// neighbour on the side of the nearest cell boundary. Each face looks at
+// 8 cells only and the search stays O(F). The earliest matching face is
+// reported. A face joins the group of that face, so a group may hold
+// faces further apart than tolerance.
+//
+// Corners scaled to cell units round by up to half an ulp of the largest
+// one, so the cells are widened by that much. Corners exactly tolerance
+// apart can not round into cells the probe misses.
+inline void searchDoubleFaceTolerance(
+    const MeshView& mesh,
+    const double tolerance,
+    MeshKernelScratch& scratch,
+    std::vector<int>& faces,
+    std::vector<uint64_t>* pairs
+) {
+    const unsigned int numFaces = mesh.numFaces;
+    const double largest = computeFaceCorners(mesh, scratch.faceOffsets, scratch.faceCorners);
+    const double inverse = 0.5 / (tolerance + 2.0 * DBL_EPSILON * (tolerance + largest));
+    const double tolerance2 = tolerance * tolerance;
+
+    FaceCellTable& table = scratch.cellTable;
+    table.reset(numFaces);
+    scratch.cellNext.resize(numFaces);
+    if (pairs != nullptr) {
+        scratch.faceRoots.resize(numFaces);
+    }
+
+    for (unsigned int faceId = 0; faceId < numFaces; ++faceId) {
+        const int count = mesh.faceCounts[faceId];
+        const int* connect = mesh.faceConnects + scratch.faceOffsets[faceId];
+        const double* corner = &scratch.faceCorners[faceId * 3];
+
+        int64_t cell[3];
+        int64_t side[3];
+        for (int a = 0; a < 3; ++a) {
+            snapGridCell(corner[a] * inverse, cell[a], side[a]);
+        }
+
+        int found = -1;
+        for (int dx = 0; dx < 2; ++dx) {
+            for (int dy = 0; dy < 2; ++dy) {
+                for (int dz = 0; dz < 2; ++dz) {
+                    const FaceCellTable::Slot& slot = findCell(table,
+                        cell[0] + dx * side[0], cell[1] + dy * side[1], cell[2] + dz * side[2]);
+                    for (int other = slot.head; other >= 0; other = scratch.cellNext[other]) {
+                        if (mesh.faceCounts[other] != count || (found >= 0 && other > found)) {
+                            continue;
+                        }
+                        const int* otherConnect = mesh.faceConnects + scratch.faceOffsets[other];
+                        if (faceVerticesWithin(mesh, connect, otherConnect, count, tolerance2)
+                            && faceVerticesWithin(mesh, otherConnect, connect, count, tolerance2)) {
+                            found = other;
+                        }
+                    }
+                }
+            }
+        }
+        if (found >= 0) {
+            faces.push_back(found);
+        }
+        if (pairs != nullptr) {
+            const int root = found >= 0 ? scratch.faceRoots[found] : static_cast<int>(faceId);
+            scratch.faceRoots[faceId] = root;
+            if (found >= 0) {
+                pairs->push_back(packFacePair(root, static_cast<int>(faceId)));
+            }
+        }
+
+        FaceCellTable::Slot& slot = findCell(table, cell[0], cell[1], cell[2]);
+        if (slot.head < 0) {
+            slot.x = cell[0];
+            slot.y = cell[1];
+            slot.z = cell[2];
+        }
+        scratch.cellNext[faceId] = slot.head;
+        slot.head = static_cast<int>(faceId);
+    }
+}
+
+// The uv kernels below work on faces [begin, end). uvOffset is the index
+// into uvSet.uvIds of the first uv of face begin.
+
+// A face is flipped when its uv winding is clockwise. Faces without uv
+// are reported too, as MItMeshPolygon::isUVReversed fails on them.
+inline void searchUVFlip(
+    const UVSetView& uvSet,
+    const unsigned int begin,
+    const unsigned int end,
+    const unsigned int uvOffset,
+    std::vector<int>& faces
+) {
+    const int* uvId = uvSet.uvIds + uvOffset;
+    for (unsigned int faceId = begin; faceId < end; ++faceId) {
+        const int count = uvSet.uvCounts[faceId];
+        if (count == 0) {
+            faces.push_back(static_cast<int>(faceId));
+            continue;
+        }
+
+        double area = 0.0;
+        for (int i = 0; i < count; ++i) {
+            const int a = uvId[i];
+            const int b = uvId[(i + 1) % count];
+            area += (double)uvSet.u[a] * uvSet.v[b] - (double)uvSet.u[b] * uvSet.v[a];
+        }
+        uvId += count;
+
+        if (area < 0.0) {
+            faces.push_back(static_cast<int>(faceId));
+        }
+    }
+}
+
+inline void searchUVNegative(
+    const UVSetView& uvSet,
+    const unsigned int begin,
+    const unsigned int end,
+    const unsigned int uvOffset,
+    std::vector<int>& faces
+) {
+    const int* uvId = uvSet.uvIds + uvOffset;
+    for (unsigned int faceId = begin; faceId < end; ++faceId) {
+        const int count = uvSet.uvCounts[faceId];
+        for (int i = 0; i < count; ++i) {
+            if (uvSet.u[uvId[i]] < 0.0f || uvSet.v[uvId[i]] < 0.0f) {
+                faces.push_back(static_cast<int>(faceId));
+                break;
+            }
+        }
+        uvId += count;
+    }
+}
+
+inline void searchUVFull(
+    const UVSetView& uvSet,
+    const unsigned int begin,
+    const unsigned int end,
+    std::vector<int>& faces
+) {
+    for (unsigned int faceId = begin; faceId < end; ++faceId) {
+        if (uvSet.uvCounts[faceId] == 0) {
+            faces.push_back(static_cast<int>(faceId));
+        }
+    }
+}
+
+inline int findShellRoot(std::vector<int>& parents, int i) {
+    while (parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+// Label uv shells: uvs used by the same face belong to the same shell.
+// Shell ids are numbered in order of their lowest uv id.
+inline unsigned int computeUVShellIds(
+    const MeshView& mesh,
+    const UVSetView& uvSet,
+    std::vector<int>& parents,
+    std::vector<int>& shellIds
+) {
+    parents.resize(uvSet.numUVs);
+    for (unsigned int i = 0; i < uvSet.numUVs; ++i) {
+        parents[i] = static_cast<int>(i);
+    }
+
+    const int* uvId = uvSet.uvIds;
+    for (unsigned int faceId = 0; faceId < mesh.numFaces; ++faceId) {
+        const int count = uvSet.uvCounts[faceId];
+        for (int i = 1; i < count; ++i) {
+            const int a = findShellRoot(parents, uvId[0]);
+            const int b = findShellRoot(parents, uvId[i]);
+            if (a != b) {
+                parents[std::max(a, b)] = std::min(a, b);
+            }
+        }
+        uvId += count;
+    }
+
+    unsigned int numShells = 0;
+    shellIds.resize(uvSet.numUVs);
+    for (unsigned int i = 0; i < uvSet.numUVs; ++i) {
+        const int root = findShellRoot(parents, static_cast<int>(i));
+        if (root == static_cast<int>(i)) {
+            shellIds[i] = static_cast<int>(numShells++);
+        }
+        else {
+            shellIds[i] = shellIds[root];
+        }
+    }
+    return numShells;
+}
+
+// Tile of a uv that is NaN, infinite or outside the int range. It is below
+// every UDIM tile, so such a uv counts as outside.
+const int kUVTileOutside = INT_MIN;
+
+// tiles[i] = floor(values[i]), 4 values per step with SSE2. Values that do
+// not floor to an int get kUVTileOutside, in both paths.
+inline void floorUVTiles(const float* values, const unsigned int count, int* tiles) {
+    const float lowest = -2147483648.0f;
+    const float highest = 2147483648.0f;
+    unsigned int i = 0;
+#if defined(UV_TILE_SSE2)
+    const __m128 lowestValue = _mm_set1_ps(lowest);
+    const __m128 highestValue = _mm_set1_ps(highest);
+    const __m128i outside = _mm_set1_epi32(kUVTileOutside);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 value = _mm_loadu_ps(values + i);
+        // false for NaN too.
+        const __m128i inside = _mm_castps_si128(_mm_and_ps(
+            _mm_cmpge_ps(value, lowestValue), _mm_cmplt_ps(value, highestValue)));
+        const __m128i truncated = _mm_cvttps_epi32(value);
+        // truncation rounds negative values up, -1 where it did.
+        const __m128 above = _mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), value);
+        const __m128i floored = _mm_add_epi32(truncated, _mm_castps_si128(above));
+        _mm_storeu_si128((__m128i*)(tiles + i),
+            _mm_or_si128(_mm_and_si128(inside, floored), _mm_andnot_si128(inside, outside)));
+    }
+#endif
+    for (; i < count; ++i) {
+        const float value = values[i];
+        tiles[i] = value >= lowest && value < highest
+            ? static_cast<int>(std::floor(value))
+            : kUVTileOutside;
+    }
+}
+
+// A uv shell must stay inside one uv tile: its min and max tile are the
+// same, in u and in v. report, when given, gets the tiles of the uvs and
+// of the shells. uvs, when given, gets the uv ids of the shells over tiles,
+// ascending.
+inline bool searchUVTilingOver(
+    const MeshView& mesh,
+    const UVSetView& uvSet,
+    MeshKernelScratch& scratch,
+    UDIMReport* report = nullptr,
+    std::vector<int>* uvs = nullptr
+) {
+    const int* uvShellIds = uvSet.shellIds;
+    unsigned int nbUvShells = uvSet.numShells;
+    if (uvShellIds == nullptr) {
+        nbUvShells = computeUVShellIds(mesh, uvSet, scratch.shellParents, scratch.shellIds);
+        uvShellIds = scratch.shellIds.data();
+    }
+
+    scratch.tileU.resize(uvSet.numUVs);
+    scratch.tileV.resize(uvSet.numUVs);
+    floorUVTiles(uvSet.u, uvSet.numUVs, scratch.tileU.data());
+    floorUVTiles(uvSet.v, uvSet.numUVs, scratch.tileV.data());
+
+    std::vector<int>& shellTiles = scratch.shellTiles;
+    shellTiles.resize(nbUvShells * 4);
+    for (unsigned int s = 0; s < nbUvShells; ++s) {
+        shellTiles[s * 4 + 0] = INT_MAX;
+        shellTiles[s * 4 + 1] = INT_MIN;
+        shellTiles[s * 4 + 2] = INT_MAX;
+        shellTiles[s * 4 + 3] = INT_MIN;
+    }
+
+    const int* tileU = scratch.tileU.data();
+    const int* tileV = scratch.tileV.data();
+    for (unsigned int uvId = 0; uvId < uvSet.numUVs; ++uvId) {
+        int* tiles = shellTiles.data() + uvShellIds[uvId] * 4;
+        tiles[0] = std::min(tiles[0], tileU[uvId]);
+        tiles[1] = std::max(tiles[1], tileU[uvId]);
+        tiles[2] = std::min(tiles[2], tileV[uvId]);
+        tiles[3] = std::max(tiles[3], tileV[uvId]);
+    }
+
+    if (report != nullptr) {
+        report->tiles.clear();
+        report->outside = false;
+        for (unsigned int uvId = 0; uvId < uvSet.numUVs; ++uvId) {
+            const int u = tileU[uvId];
+            const int v = tileV[uvId];
+            if (u < 0 || u >= 10 || v < 0 || v >= kUDIMRows) {
+                report->outside = true;
+                continue;
+            }
+            const unsigned int bit = static_cast<unsigned int>(u + 10 * v);
+            if (report->tiles.size() <= bit / 64) {
+                report->tiles.resize(bit / 64 + 1, 0);
+            }
+            report->tiles[bit / 64] |= 1ull << (bit % 64);
+        }
+        report->shellTiles = shellTiles;
+    }
+
+    if (uvs != nullptr) {
+        const size_t first = uvs->size();
+        for (unsigned int uvId = 0; uvId < uvSet.numUVs; ++uvId) {
+            const int* tiles = shellTiles.data() + uvShellIds[uvId] * 4;
+            if (tiles[0] != tiles[1] || tiles[2] != tiles[3]) {
+                uvs->push_back(static_cast<int>(uvId));
+            }
+        }
+        return uvs->size() > first;
+    }
+
+    for (unsigned int s = 0; s < nbUvShells; ++s) {
+        const int* tiles = shellTiles.data() + s * 4;
+        if (tiles[0] != tiles[1] || tiles[2] != tiles[3]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool searchFreeze(const MeshView& mesh) {
+    for (unsigned int i = 0; i < mesh.numTweaks * 3; ++i) {
+        if (mesh.tweaks[i] != 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool searchNormalLock(const MeshView& mesh) {
+    for (unsigned int n = 0; n < mesh.numNormals; ++n) {
+        if (mesh.normalLocked[n]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Run every check in checks on one mesh. uvSets are the indices into
+// mesh.uvSets to look at, empty when the uv checks should be skipped.
+inline void runMeshKernels(
+    const MeshView& mesh,
+    const std::vector<MeshCheckKind>& checks,
+    const std::vector<unsigned int>& uvSets,
+    const MeshKernelOptions& options,
+    MeshKernelScratch& scratch,
+    MeshCheckResult& result
+) {
+    result.clear();
+
+    for (const auto& kind : checks) {
+        if (isUVCheck(kind) && (mesh.numFaces == 0 || uvSets.empty())) {
+            continue;
+        }
+
+        std::vector<int>& faces = result.faces[kind];
+        switch (kind) {
+        case kMeshDoubleFace: {
+            std::vector<uint64_t>* pairs = options.doubleFaceGroups ? &scratch.facePairs : nullptr;
+            scratch.facePairs.clear();
+            if (options.tolerance > 0.0) {
+                searchDoubleFaceTolerance(mesh, options.tolerance, scratch, faces, pairs);
+            }
+            else {
+                searchDoubleFace(mesh, scratch, faces, pairs);
+            }
+            if (pairs != nullptr) {
+                buildFaceGroups(scratch.facePairs, result.doubleFaceGroups);
+            }
+            break;
+        }
+        case kMeshFreeze:
+            result.invalid[kind] = searchFreeze(mesh);
+            break;
+        case kMeshUVFlip:
+            for (const auto& s : uvSets) {
+                searchUVFlip(mesh.uvSets[s], 0, mesh.numFaces, 0, faces);
+            }
+            break;
+        case kMeshUVNegative:
+            for (const auto& s : uvSets) {
+                searchUVNegative(mesh.uvSets[s], 0, mesh.numFaces, 0, faces);
+            }
+            break;
+        case kMeshUVFull:
+            for (const auto& s : uvSets) {
+                searchUVFull(mesh.uvSets[s], 0, mesh.numFaces, faces);
+            }
+            break;
+        case kMeshUVTilingOver: {
+            std::vector<int>* uvs = options.tilingOverUVs ? &faces : nullptr;
+            for (const auto& s : uvSets) {
+                UDIMReport* report = nullptr;
+                if (options.udimReport) {
+                    result.udimReports.emplace_back();
+                    report = &result.udimReports.back();
+                    report->uvSet = s;
+                }
+                if (searchUVTilingOver(mesh, mesh.uvSets[s], scratch, report, uvs)) {
+                    result.invalid[kind] = true;
+                    if (report == nullptr && uvs == nullptr) {
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+        case kMeshNormalLock:
+            result.invalid[kind] = searchNormalLock(mesh);
+            break;
+        case kMeshFace0Count:
+            result.invalid[kind] = mesh.numFaces == 0;
+            break;
+        default:
+            break;
+        }
+
+        if (!faces.empty()) {
+            sortUnique(faces);
+            result.invalid[kind] = true;
+        }
+    }
+}
+
+// ==========================================================================
+// large meshes
+//
+// Meshes with at least splitFaces faces run the face checks on face ranges
+// in parallel. The uv checks work on each range independently. The double
+// face search first hashes the face signatures of each range into
+// partitions, then walks every partition in face order, so faces with the
+// same signature meet in the same order as in the serial search. The merged result is
+// identical to runMeshKernels. The double face search with a tolerance
+// looks at neighbouring cells, it runs on the whole mesh.
+
+// 0 disables the split.
+const unsigned int kDefaultSplitFaces = 500000;
+
+inline bool isSplitCheck(const MeshCheckKind kind) {
+    return isFaceCheck(kind);
+}
+
+// Checks that make a large mesh worth splitting: the face checks, and uv
+// tiling over, whose uv shells are labelled on the face ranges.
+inline bool isSplitMeshCheck(const MeshCheckKind kind) {
+    return isSplitCheck(kind) || kind == kMeshUVTilingOver;
+}
+
+// Partition of a face signature hash. Uses the high bits so the faces of one
+// partition do not share the low bits the hash tables bucket with.
+inline unsigned int hashPartition(const size_t hash, const unsigned int count) {
+    const unsigned long long mixed = (unsigned long long)hash * 0x9E3779B97F4A7C15ull;
+    return static_cast<unsigned int>(((mixed >> 32) * count) >> 32);
+}
+
+struct FaceRangeScratch
+{
+    std::vector<int> faces[kMeshCheckCount];
+    // double face, face ids of this range per partition.
+    std::vector<std::vector<int>> partitions;
+};
+
+struct MeshSplitScratch
+{
+    // range r is faces [begins[r], begins[r + 1]).
+    std::vector<unsigned int> begins;
+    std::vector<unsigned int> connectOffsets;
+    // [uv set slot][range]
+    std::vector<std::vector<unsigned int>> uvOffsets;
+    // double face, index into faceConnects and signature hash per face.
+    std::vector<unsigned int> faceOffsets;
+    std::vector<uint64_t>     faceHashes;
+
+    std::vector<FaceRangeScratch> ranges;
+    std::vector<MeshKernelScratch> partitions;
+    std::vector<std::vector<int>> partitionFaces;
+    std::vector<std::vector<uint64_t>> partitionPairs;
+
+    // uv tiling over, one parent per uv, shared by the ranges.
+    std::unique_ptr<std::atomic<int>[]> shellParents;
+    unsigned int shellCapacity = 0;
+    // roots per uv range, then the first shell id of the range.
+    std::vector<unsigned int> shellCounts;
+    std::vector<int> shellIds;
+};
+
+// Cut the faces of mesh into at most numRanges ranges and find where each
+// range starts in faceConnects and in the uvIds of every uv set.
+inline void splitFaceRanges(
+    const MeshView& mesh,
+    const std::vector<unsigned int>& uvSets,
+    const bool needConnects,
+    const unsigned int numRanges,
+    MeshSplitScratch& split
+) {
+    const unsigned int numFaces = mesh.numFaces;
+    const unsigned int count = std::max(1u, std::min(numRanges, numFaces));
+
+    split.begins.resize(count + 1);
+    for (unsigned int r = 0; r <= count; ++r) {
+        split.begins[r] = static_cast<unsigned int>((unsigned long long)numFaces * r / count);
+    }
+
+    auto offsets = [&](const int* counts, std::vector<unsigned int>& result) {
+        result.resize(count);
+        unsigned int offset = 0;
+        unsigned int r = 0;
+        for (unsigned int faceId = 0; faceId < numFaces; ++faceId) {
+            if (faceId == split.begins[r]) {
+                result[r++] = offset;
+            }
+            offset += counts[faceId];
+        }
+    };
+
+    if (needConnects) {
+        offsets(mesh.faceCounts, split.connectOffsets);
+    }
+    split.uvOffsets.resize(uvSets.size());
+    for (size_t s = 0; s < uvSets.size(); ++s) {
+        offsets(mesh.uvSets[uvSets[s]].uvCounts, split.uvOffsets[s]);
+    }
+
+    if (split.ranges.size() < count) {
+        split.ranges.resize(count);
+    }
+}
+
+inline int findShellRoot(std::atomic<int>* parents, int i) {
+    for (;;) {
+        int parent = parents[i].load(std::memory_order_relaxed);
+        if (parent == i) {
+            return i;
+        }
+        const int grandParent = parents[parent].load(std::memory_order_relaxed);
+        if (grandParent != parent) {
+            // path halving, a lost race only skips the shortcut.
+            parents[i].compare_exchange_weak(parent, grandParent, std::memory_order_relaxed);
+        }
+        i = grandParent;
+    }
+}
+
+// Join the shells of uvs a and b. Like computeUVShellIds the larger root
+// is linked to the smaller one, so the root of a shell is its lowest uv
+// id whatever the order of the joins.
+inline void uniteShells(std::atomic<int>* parents, int a, int b) {
+    for (;;) {
+        a = findShellRoot(parents, a);
+        b = findShellRoot(parents, b);
+        if (a == b) {
+            return;
+        }
+        if (a < b) {
+            std::swap(a, b);
+        }
+        // fails when another range linked a first, then retry from there.
+        int expected = a;
+        if (parents[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+// computeUVShellIds on the face ranges of splitFaceRanges, uvSet is the uv
+// set in slot of its uvSets. Every range joins the uvs of its faces in one
+// shared parent array, then the roots are numbered on uv ranges. The ids
+// are the same as those of computeUVShellIds. parallelFor as for
+// runMeshKernelsSplit.
+template<typename ParallelFor>
+unsigned int computeUVShellIdsSplit(
+    const UVSetView& uvSet,
+    const size_t slot,
+    ParallelFor parallelFor,
+    MeshSplitScratch& split,
+    std::vector<int>& shellIds
+) {
+    const unsigned int count = static_cast<unsigned int>(split.begins.size() - 1);
+    const unsigned int numUVs = uvSet.numUVs;
+    if (split.shellCapacity < numUVs) {
+        split.shellParents.reset(new std::atomic<int>[numUVs]);
+        split.shellCapacity = numUVs;
+    }
+    std::atomic<int>* parents = split.shellParents.get();
+    shellIds.resize(numUVs);
+    split.shellCounts.resize(count);
+
+    auto uvBegin = [&](const unsigned int r) {
+        return static_cast<unsigned int>((unsigned long long)numUVs * r / count);
+    };
+
+    // the passes only share the parents, relaxed order is enough within a
+    // pass and parallelFor joins between them.
+    parallelFor(count, [&](unsigned int r) {
+        for (unsigned int i = uvBegin(r); i < uvBegin(r + 1); ++i) {
+            parents[i].store(static_cast<int>(i), std::memory_order_relaxed);
+        }
+    });
+
+    parallelFor(count, [&](unsigned int r) {
+        const int* uvId = uvSet.uvIds + split.uvOffsets[slot][r];
+        for (unsigned int faceId = split.begins[r]; faceId < split.begins[r + 1]; ++faceId) {
+            const int faceCount = uvSet.uvCounts[faceId];
+            for (int i = 1; i < faceCount; ++i) {
+                uniteShells(parents, uvId[0], uvId[i]);
+            }
+            uvId += faceCount;
+        }
+    });
+
+    parallelFor(count, [&](unsigned int r) {
+        unsigned int numRoots = 0;
+        for (unsigned int i = uvBegin(r); i < uvBegin(r + 1); ++i) {
+            numRoots += parents[i].load(std::memory_order_relaxed) == static_cast<int>(i) ? 1 : 0;
+        }
+        split.shellCounts[r] = numRoots;
+    });
+
+    unsigned int numShells = 0;
+    for (auto& shellCount : split.shellCounts) {
+        const unsigned int numRoots = shellCount;
+        shellCount = numShells;
+        numShells += numRoots;
+    }
+
+    parallelFor(count, [&](unsigned int r) {
+        int shellId = static_cast<int>(split.shellCounts[r]);
+        for (unsigned int i = uvBegin(r); i < uvBegin(r + 1); ++i) {
+            if (parents[i].load(std::memory_order_relaxed) == static_cast<int>(i)) {
+                shellIds[i] = shellId++;
+            }
+        }
+    });
+
+    parallelFor(count, [&](unsigned int r) {
+        for (unsigned int i = uvBegin(r); i < uvBegin(r + 1); ++i) {
+            const int root = findShellRoot(parents, static_cast<int>(i));
+            if (root != static_cast<int>(i)) {
+                shellIds[i] = shellIds[root];
+            }
+        }
+    });
+    return numShells;
+}
+
+// Same as runMeshKernels, with the face checks spread over numRanges face
+// ranges. parallelFor(n, body) must call body(i) for every i in [0, n)
+// and return once all calls are done.
+template<typename ParallelFor>
+void runMeshKernelsSplit(
+    const MeshView& mesh,
+    const std::vector<MeshCheckKind>& checks,
+    const std::vector<unsigned int>& uvSets,
+    const unsigned int numRanges,
+    const MeshKernelOptions& options,
+    ParallelFor parallelFor,
+    MeshKernelScratch& scratch,
+    MeshSplitScratch& split,
+    MeshCheckResult& result
+) {
+    std::vector<MeshCheckKind> wholeChecks;
+    std::vector<MeshCheckKind> rangeChecks;
+    bool doubleFace = false;
+    bool tilingOver = false;
+    for (const auto& kind : checks) {
+        if (kind == kMeshUVTilingOver && mesh.numFaces > 0 && !uvSets.empty()) {
+            tilingOver = true;
+        }
+        else if (!isSplitCheck(kind) || (kind == kMeshDoubleFace && options.tolerance > 0.0)) {
+            wholeChecks.push_back(kind);
+        }
+        else if (kind == kMeshDoubleFace) {
+            doubleFace = true;
+        }
+        else if (mesh.numFaces > 0 && !uvSets.empty()) {
+            rangeChecks.push_back(kind);
+        }
+    }
+
+    runMeshKernels(mesh, wholeChecks, uvSets, options, scratch, result);
+
+    splitFaceRanges(mesh, uvSets, doubleFace, numRanges, split);
+    const unsigned int count = static_cast<unsigned int>(split.begins.size() - 1);
+
+    // uv tiling over, on shells labelled on the ranges unless the uv set
+    // has them already.
+    if (tilingOver) {
+        std::vector<int>& uvs = result.faces[kMeshUVTilingOver];
+        for (size_t s = 0; s < uvSets.size(); ++s) {
+            UVSetView uvSet = mesh.uvSets[uvSets[s]];
+            if (uvSet.shellIds == nullptr) {
+                uvSet.numShells = computeUVShellIdsSplit(uvSet, s, parallelFor, split, split.shellIds);
+                uvSet.shellIds = split.shellIds.data();
+            }
+            UDIMReport* report = nullptr;
+            if (options.udimReport) {
+                result.udimReports.emplace_back();
+                report = &result.udimReports.back();
+                report->uvSet = uvSets[s];
+            }
+            if (searchUVTilingOver(mesh, uvSet, scratch, report, options.tilingOverUVs ? &uvs : nullptr)) {
+                result.invalid[kMeshUVTilingOver] = true;
+                if (report == nullptr && !options.tilingOverUVs) {
+                    break;
+                }
+            }
+        }
+        sortUnique(uvs);
+    }
+
+    if (doubleFace) {
+        split.faceOffsets.resize(mesh.numFaces);
+        split.faceHashes.resize(mesh.numFaces);
+        if (split.partitions.size() < count) {
+            split.partitions.resize(count);
+        }
+        split.partitionFaces.resize(count);
+        split.partitionPairs.resize(count);
+    }
+
+    // ranges: uv checks and double face partitioning.
+    parallelFor(count, [&](unsigned int r) {
+        FaceRangeScratch& range = split.ranges[r];
+        const unsigned int begin = split.begins[r];
+        const unsigned int end = split.begins[r + 1];
+
+        for (const auto& kind : rangeChecks) {
+            std::vector<int>& faces = range.faces[kind];
+            faces.clear();
+            for (size_t s = 0; s < uvSets.size(); ++s) {
+                const UVSetView& uvSet = mesh.uvSets[uvSets[s]];
+                const unsigned int uvOffset = split.uvOffsets[s][r];
+                if (kind == kMeshUVFlip) {
+                    searchUVFlip(uvSet, begin, end, uvOffset, faces);
+                }
+                else if (kind == kMeshUVNegative) {
+                    searchUVNegative(uvSet, begin, end, uvOffset, faces);
+                }
+                else if (kind == kMeshUVFull) {
+                    searchUVFull(uvSet, begin, end, faces);
+                }
+            }
+        }
+
+        if (!doubleFace) {
+            return;
+        }
+        range.partitions.resize(count);
+        for (auto& partition : range.partitions) {
+            partition.clear();
+        }
+        unsigned int offset = split.connectOffsets[r];
+        for (unsigned int faceId = begin; faceId < end; ++faceId) {
+            const int faceCount = mesh.faceCounts[faceId];
+            const uint64_t hash = faceSignatureHash(mesh, mesh.faceConnects + offset, faceCount);
+            range.partitions[hashPartition(static_cast<size_t>(hash), count)].push_back(static_cast<int>(faceId));
+            split.faceOffsets[faceId] = offset;
+            split.faceHashes[faceId] = hash;
+            offset += faceCount;
+        }
+    });
+
+    // partitions: double face search in face order.
+    if (doubleFace) {
+        parallelFor(count, [&](unsigned int p) {
+            MeshKernelScratch& partition = split.partitions[p];
+            std::vector<int>& faces = split.partitionFaces[p];
+            faces.clear();
+            std::vector<uint64_t>* pairs = options.doubleFaceGroups ? &split.partitionPairs[p] : nullptr;
+            split.partitionPairs[p].clear();
+
+            size_t numFaces = 0;
+            for (unsigned int r = 0; r < count; ++r) {
+                numFaces += split.ranges[r].partitions[p].size();
+            }
+            partition.faceTable.reset(numFaces);
+
+            for (unsigned int r = 0; r < count; ++r) {
+                for (const auto& faceId : split.ranges[r].partitions[p]) {
+                    searchDoubleFaceStep(mesh, faceId, split.faceOffsets[faceId], split.faceHashes[faceId], partition, faces, pairs);
+                }
+            }
+        });
+    }
+
+    // merge in range order.
+    for (const auto& kind : checks) {
+        if (!isSplitCheck(kind)) {
+            continue;
+        }
+        std::vector<int>& faces = result.faces[kind];
+        if (kind == kMeshDoubleFace && doubleFace) {
+            for (unsigned int p = 0; p < count; ++p) {
+                faces.insert(faces.end(), split.partitionFaces[p].begin(), split.partitionFaces[p].end());
+            }
+            if (options.doubleFaceGroups) {
+                // the faces of a group meet in one partition.
+                std::vector<uint64_t>& pairs = scratch.facePairs;
+                pairs.clear();
+                for (unsigned int p = 0; p < count; ++p) {
+                    pairs.insert(pairs.end(), split.partitionPairs[p].begin(), split.partitionPairs[p].end());
+                }
+                buildFaceGroups(pairs, result.doubleFaceGroups);
+            }
+        }
+        else if (std::find(rangeChecks.begin(), rangeChecks.end(), kind) != rangeChecks.end()) {
+            for (unsigned int r = 0; r < count; ++r) {
+                faces.insert(faces.end(), split.ranges[r].faces[kind].begin(), split.ranges[r].faces[kind].end());
+            }
+        }
+
+        if (!faces.empty()) {
+            sortUnique(faces);
+            result.invalid[kind] = true;
+        }
+    }
+}
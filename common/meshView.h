@@ -0,0 +1,151 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Flat, Maya independent view of a polygon mesh.
+//
+// The layout follows MFnMesh so the Maya side can point the view at its own
+// arrays: points are xyz triples, faces are stored as faceCounts plus
+// faceConnects, and every uv set has per face uvCounts plus uvIds.
+// Nothing here includes a Maya header.
+
+#include <string>
+#include <vector>
+
+struct UVSetView
+{
+    UVSetView()
+        : u(nullptr), v(nullptr), numUVs(0)
+        , uvCounts(nullptr), uvIds(nullptr), numUVIds(0)
+        , shellIds(nullptr), numShells(0)
+    {}
+
+    const float* u;
+    const float* v;
+    unsigned int numUVs;
+
+    // per face uv count, 0 when the face has no uv in this set.
+    const int* uvCounts;
+    // assigned uv ids, laid out like faceConnects for the mapped faces.
+    const int* uvIds;
+    unsigned int numUVIds;
+
+    // optional shell id per uv. null when not known yet.
+    const int* shellIds;
+    unsigned int numShells;
+};
+
+struct MeshView
+{
+    MeshView()
+        : points(nullptr), numVertices(0)
+        , faceCounts(nullptr), numFaces(0)
+        , faceConnects(nullptr), numFaceVertices(0)
+        , tweaks(nullptr), numTweaks(0)
+        , normalLocked(nullptr), numNormals(0)
+    {}
+
+    // xyz per vertex, object space.
+    const float* points;
+    unsigned int numVertices;
+
+    const int* faceCounts;
+    unsigned int numFaces;
+
+    const int* faceConnects;
+    unsigned int numFaceVertices;
+
+    // xyz per pnts element.
+    const float* tweaks;
+    unsigned int numTweaks;
+
+    // one flag per normal.
+    const unsigned char* normalLocked;
+    unsigned int numNormals;
+
+    std::vector<UVSetView> uvSets;
+};
+
+// Owning storage behind a MeshView, used where Maya is not available.
+struct UVSetData
+{
+    std::string name;
+    std::vector<float> u;
+    std::vector<float> v;
+    std::vector<int> uvCounts;
+    std::vector<int> uvIds;
+    std::vector<int> shellIds;
+    unsigned int numShells = 0;
+};
+
+struct MeshData
+{
+    std::string name;
+    std::vector<float> points;
+    std::vector<int> faceCounts;
+    std::vector<int> faceConnects;
+    std::vector<float> tweaks;
+    std::vector<unsigned char> normalLocked;
+    std::vector<UVSetData> uvSets;
+
+    MeshView view() const {
+        MeshView mesh;
+        mesh.points = points.data();
+        mesh.numVertices = static_cast<unsigned int>(points.size() / 3);
+        mesh.faceCounts = faceCounts.data();
+        mesh.numFaces = static_cast<unsigned int>(faceCounts.size());
+        mesh.faceConnects = faceConnects.data();
+        mesh.numFaceVertices = static_cast<unsigned int>(faceConnects.size());
+        mesh.tweaks = tweaks.data();
+        mesh.numTweaks = static_cast<unsigned int>(tweaks.size() / 3);
+        mesh.normalLocked = normalLocked.data();
+        mesh.numNormals = static_cast<unsigned int>(normalLocked.size());
+
+        mesh.uvSets.resize(uvSets.size());
+        for (size_t s = 0; s < uvSets.size(); ++s) {
+            const UVSetData& src = uvSets[s];
+            UVSetView& dst = mesh.uvSets[s];
+            dst.u = src.u.data();
+            dst.v = src.v.data();
+            dst.numUVs = static_cast<unsigned int>(src.u.size());
+            dst.uvCounts = src.uvCounts.data();
+            dst.uvIds = src.uvIds.data();
+            dst.numUVIds = static_cast<unsigned int>(src.uvIds.size());
+            if (!src.shellIds.empty()) {
+                dst.shellIds = src.shellIds.data();
+                dst.numShells = src.numShells;
+            }
+        }
+        return mesh;
+    }
+
+    int findUVSet(const std::string& uvSetName) const {
+        for (size_t s = 0; s < uvSets.size(); ++s) {
+            if (uvSets[s].name == uvSetName) {
+                return static_cast<int>(s);
+            }
+        }
+        return -1;
+    }
+};
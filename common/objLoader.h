@@ -0,0 +1,219 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Minimal Wavefront OBJ reader for the headless tools.
+//
+// Every "o" or "g" record starts a new mesh. Vertex and uv indices are
+// remapped per mesh, texture coordinates go into a uv set named "map1".
+// Normals, materials and free-form geometry are ignored.
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "meshView.h"
+
+namespace objLoader
+{
+    struct FaceVertex
+    {
+        int v;
+        int vt;
+    };
+
+    // OBJ indices are 1 based, negative values are relative to the end.
+    inline int resolveIndex(const int index, const size_t count) {
+        if (index > 0) {
+            return index - 1;
+        }
+        if (index < 0) {
+            return static_cast<int>(count) + index;
+        }
+        return -1;
+    }
+
+    struct ObjectBuilder
+    {
+        std::string name;
+        std::vector<int> faceCounts;
+        std::vector<FaceVertex> faceVertices;
+        std::vector<int> uvCounts;
+
+        bool empty() const {
+            return faceCounts.empty();
+        }
+
+        void build(
+            const std::vector<float>& positions,
+            const std::vector<float>& texcoords,
+            MeshData& mesh
+        ) const {
+            mesh = MeshData();
+            mesh.name = name;
+            mesh.faceCounts = faceCounts;
+            mesh.faceConnects.reserve(faceVertices.size());
+
+            std::vector<int> vertexMap(positions.size() / 3, -1);
+            std::vector<int> uvMap(texcoords.size() / 2, -1);
+
+            UVSetData uvSet;
+            uvSet.name = "map1";
+            uvSet.uvCounts = uvCounts;
+
+            size_t offset = 0;
+            for (size_t f = 0; f < faceCounts.size(); ++f) {
+                for (int i = 0; i < faceCounts[f]; ++i) {
+                    const FaceVertex& fv = faceVertices[offset + i];
+
+                    int& local = vertexMap[fv.v];
+                    if (local < 0) {
+                        local = static_cast<int>(mesh.points.size() / 3);
+                        mesh.points.push_back(positions[fv.v * 3 + 0]);
+                        mesh.points.push_back(positions[fv.v * 3 + 1]);
+                        mesh.points.push_back(positions[fv.v * 3 + 2]);
+                    }
+                    mesh.faceConnects.push_back(local);
+
+                    if (uvCounts[f] == 0) {
+                        continue;
+                    }
+
+                    int& localUV = uvMap[fv.vt];
+                    if (localUV < 0) {
+                        localUV = static_cast<int>(uvSet.u.size());
+                        uvSet.u.push_back(texcoords[fv.vt * 2 + 0]);
+                        uvSet.v.push_back(texcoords[fv.vt * 2 + 1]);
+                    }
+                    uvSet.uvIds.push_back(localUV);
+                }
+                offset += faceCounts[f];
+            }
+
+            mesh.uvSets.push_back(uvSet);
+        }
+    };
+};
+
+// Append every mesh of the OBJ file at path to meshes. Mesh names are
+// prefixed with prefix. Returns false and fills error on failure.
+inline bool loadObj(
+    const std::string& path,
+    const std::string& prefix,
+    std::vector<MeshData>& meshes,
+    std::string& error
+) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        error = "could not open " + path + ".";
+        return false;
+    }
+
+    std::vector<float> positions;
+    std::vector<float> texcoords;
+    objLoader::ObjectBuilder object;
+    object.name = "default";
+
+    std::string line;
+    std::string tag;
+    std::string token;
+    unsigned int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        std::istringstream stream(line);
+        if (!(stream >> tag) || tag[0] == '#') {
+            continue;
+        }
+
+        if (tag == "v") {
+            float x = 0, y = 0, z = 0;
+            stream >> x >> y >> z;
+            positions.push_back(x);
+            positions.push_back(y);
+            positions.push_back(z);
+        }
+        else if (tag == "vt") {
+            float u = 0, v = 0;
+            stream >> u >> v;
+            texcoords.push_back(u);
+            texcoords.push_back(v);
+        }
+        else if (tag == "o" || tag == "g") {
+            std::string name;
+            std::getline(stream >> std::ws, name);
+            if (!object.empty()) {
+                meshes.push_back(MeshData());
+                object.build(positions, texcoords, meshes.back());
+                meshes.back().name = prefix + meshes.back().name;
+                object = objLoader::ObjectBuilder();
+            }
+            object.name = name.empty() ? "default" : name;
+        }
+        else if (tag == "f") {
+            int count = 0;
+            bool hasUV = true;
+            const size_t first = object.faceVertices.size();
+            while (stream >> token) {
+                objLoader::FaceVertex fv;
+                fv.v = objLoader::resolveIndex(std::atoi(token.c_str()), positions.size() / 3);
+                fv.vt = -1;
+
+                const size_t slash = token.find('/');
+                const bool hasTexcoord = slash != std::string::npos && slash + 1 < token.size() && token[slash + 1] != '/';
+                if (hasTexcoord) {
+                    fv.vt = objLoader::resolveIndex(std::atoi(token.c_str() + slash + 1), texcoords.size() / 2);
+                }
+
+                if (fv.v < 0 || fv.v >= static_cast<int>(positions.size() / 3)) {
+                    error = path + ":" + std::to_string(lineNumber) + ": vertex index out of range.";
+                    return false;
+                }
+                if (hasTexcoord && (fv.vt < 0 || fv.vt >= static_cast<int>(texcoords.size() / 2))) {
+                    error = path + ":" + std::to_string(lineNumber) + ": uv index out of range.";
+                    return false;
+                }
+
+                hasUV &= fv.vt >= 0;
+                object.faceVertices.push_back(fv);
+                ++count;
+            }
+
+            if (count < 3) {
+                object.faceVertices.resize(first);
+                continue;
+            }
+            object.faceCounts.push_back(count);
+            object.uvCounts.push_back(hasUV ? count : 0);
+        }
+    }
+
+    if (!object.empty()) {
+        meshes.push_back(MeshData());
+        object.build(positions, texcoords, meshes.back());
+        meshes.back().name = prefix + meshes.back().name;
+    }
+    return true;
+}
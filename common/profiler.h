@@ -0,0 +1,200 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Per stage profiler.
+//
+// Stages are always recorded, they cost two clock reads each. Per item
+// (mesh) times are only recorded when the profiler is enabled. The result
+// is written as JSON together with the worker stats of the scheduler.
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "scheduler.h"
+
+class Profiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Stage
+    {
+        std::string name;
+        double sec;
+    };
+
+    Profiler() : _enabled(false), _slowest(10) {}
+
+    // slowest is the number of items kept in the report.
+    void enable(const unsigned int slowest) {
+        _enabled = true;
+        _slowest = slowest;
+    }
+
+    bool enabled() const {
+        return _enabled;
+    }
+
+    unsigned int slowest() const {
+        return _slowest;
+    }
+
+    static Clock::time_point now() {
+        return Clock::now();
+    }
+
+    static double seconds(const Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Record a stage that started at start and ends now.
+    void addStage(const char* name, const Clock::time_point start) {
+        Stage stage;
+        stage.name = name;
+        stage.sec = seconds(start);
+        _stages.push_back(stage);
+    }
+
+    const std::vector<Stage>& stages() const {
+        return _stages;
+    }
+
+    void resetItems(const size_t numItems) {
+        _itemSec.assign(_enabled ? numItems : 0, 0.0);
+    }
+
+    // Every item is written by one worker only, no lock is needed.
+    void setItemTime(const size_t item, const double sec) {
+        if (item < _itemSec.size()) {
+            _itemSec[item] = sec;
+        }
+    }
+
+    // Items sorted by time, slowest first, at most slowest() of them.
+    std::vector<unsigned int> slowestItems() const {
+        std::vector<unsigned int> items(_itemSec.size());
+        for (unsigned int i = 0; i < items.size(); ++i) {
+            items[i] = i;
+        }
+        const size_t count = std::min<size_t>(_slowest, items.size());
+        std::partial_sort(items.begin(), items.begin() + count, items.end(), [&](unsigned int a, unsigned int b) {
+            return _itemSec[a] > _itemSec[b];
+        });
+        items.resize(count);
+        return items;
+    }
+
+    double itemTime(const size_t item) const {
+        return _itemSec[item];
+    }
+
+private:
+    bool _enabled;
+    unsigned int _slowest;
+    std::vector<Stage> _stages;
+    std::vector<double> _itemSec;
+};
+
+inline void appendJsonString(std::string& out, const char* value) {
+    out += '"';
+    for (const char* c = value; *c != '\0'; ++c) {
+        switch (*c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(*c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+                out += escaped;
+            }
+            else {
+                out += *c;
+            }
+            break;
+        }
+    }
+    out += '"';
+}
+
+inline void appendJsonNumber(std::string& out, const double value) {
+    char number[32];
+    snprintf(number, sizeof(number), "%.9g", value);
+    out += number;
+}
+
+// Write {"stages":[...],"workers":[...],"slowest":[...]<members>} to out.
+// itemName(i) gives the name of item i, members is appended as is and
+// must start with a comma when it is not empty.
+template<typename ItemName>
+void writeProfileJson(
+    std::string& out,
+    const Profiler& profiler,
+    const WorkScheduler& scheduler,
+    ItemName itemName,
+    const std::string& members
+) {
+    out += "{\"stages\":[";
+    const auto& stages = profiler.stages();
+    for (size_t i = 0; i < stages.size(); ++i) {
+        out += i == 0 ? "{\"name\":" : ",{\"name\":";
+        appendJsonString(out, stages[i].name.c_str());
+        out += ",\"sec\":";
+        appendJsonNumber(out, stages[i].sec);
+        out += "}";
+    }
+
+    out += "],\"workers\":[";
+    const auto& workers = scheduler.stats();
+    for (size_t w = 0; w < workers.size(); ++w) {
+        out += w == 0 ? "{\"items\":" : ",{\"items\":";
+        appendJsonNumber(out, workers[w].items);
+        out += ",\"stolen\":";
+        appendJsonNumber(out, workers[w].stolen);
+        out += ",\"cost\":";
+        appendJsonNumber(out, workers[w].cost);
+        out += ",\"busySec\":";
+        appendJsonNumber(out, workers[w].busySec);
+        out += "}";
+    }
+
+    out += "],\"slowest\":[";
+    const auto slowest = profiler.slowestItems();
+    for (size_t i = 0; i < slowest.size(); ++i) {
+        out += i == 0 ? "{\"name\":" : ",{\"name\":";
+        appendJsonString(out, itemName(slowest[i]).c_str());
+        out += ",\"sec\":";
+        appendJsonNumber(out, profiler.itemTime(slowest[i]));
+        out += "}";
+    }
+    out += "]";
+    out += members;
+    out += "}";
+}
@@ -0,0 +1,310 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Synthetic scenes for the benchmark.
+//
+// Meshes are quad grids with one uv per vertex, curves are open polylines
+// of cvs. Defects are injected at defectRate:
+//   per face  : duplicated face, negative uvs, flipped uvs, unmapped face
+//   per mesh  : uv shell crossing a tile, locked normal, non zero pnts
+//   per curve : zero spans, cv coincident with another curve
+// The random sequence only depends on the seed, so a scene is the same on
+// every platform.
+
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "curveView.h"
+#include "meshView.h"
+
+struct GeneratorOptions
+{
+    GeneratorOptions()
+        : numMeshes(100), facesPerMesh(10000)
+        , numCurves(1000), cvsPerCurve(32)
+        , defectRate(0.001), seed(1)
+    {}
+
+    unsigned int numMeshes;
+    // rounded to a square grid.
+    unsigned int facesPerMesh;
+    unsigned int numCurves;
+    unsigned int cvsPerCurve;
+    double defectRate;
+    uint64_t seed;
+};
+
+// splitmix64, the standard distributions are implementation defined.
+class GeneratorRandom
+{
+public:
+    explicit GeneratorRandom(const uint64_t seed) : _state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // [0, 1)
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // [0, n)
+    unsigned int below(const unsigned int n) {
+        return static_cast<unsigned int>(uniform() * n);
+    }
+
+    bool chance(const double rate) {
+        return uniform() < rate;
+    }
+
+private:
+    uint64_t _state;
+};
+
+// Number of injected defects, to check the kernels find what was put in.
+struct GeneratorStats
+{
+    unsigned int doubleFaces = 0;
+    unsigned int negativeUVFaces = 0;
+    unsigned int flippedUVFaces = 0;
+    unsigned int unmappedFaces = 0;
+    unsigned int tilingOverMeshes = 0;
+    unsigned int normalLockMeshes = 0;
+    unsigned int freezeMeshes = 0;
+    unsigned int spans0Curves = 0;
+    unsigned int samePositionCurves = 0;
+};
+
+inline void generateMesh(
+    const std::string& name,
+    const unsigned int resolution,
+    const GeneratorOptions& options,
+    GeneratorRandom& random,
+    GeneratorStats& stats,
+    MeshData& mesh
+) {
+    const double rate = options.defectRate;
+    const unsigned int n = std::max(1u, resolution);
+    const unsigned int numVertices = (n + 1) * (n + 1);
+
+    mesh = MeshData();
+    mesh.name = name;
+
+    // offset each mesh so meshes do not overlap.
+    const float offset = static_cast<float>(random.below(1000000));
+    mesh.points.reserve(numVertices * 3);
+    for (unsigned int y = 0; y <= n; ++y) {
+        for (unsigned int x = 0; x <= n; ++x) {
+            mesh.points.push_back(offset + static_cast<float>(x));
+            mesh.points.push_back(static_cast<float>(y));
+            mesh.points.push_back(static_cast<float>(random.below(4)) * 0.25f);
+        }
+    }
+
+    UVSetData uvSet;
+    uvSet.name = "map1";
+    uvSet.u.reserve(numVertices);
+    uvSet.v.reserve(numVertices);
+    const bool tilingOver = random.chance(rate);
+    // a shell crossing u = 1 when tilingOver.
+    const float shift = tilingOver ? 0.5f : 0.0f;
+    stats.tilingOverMeshes += tilingOver ? 1 : 0;
+    for (unsigned int y = 0; y <= n; ++y) {
+        for (unsigned int x = 0; x <= n; ++x) {
+            uvSet.u.push_back(shift + static_cast<float>(x) / n * 0.999f);
+            uvSet.v.push_back(static_cast<float>(y) / n * 0.999f);
+        }
+    }
+
+    mesh.faceCounts.reserve(n * n);
+    mesh.faceConnects.reserve(n * n * 4);
+    uvSet.uvCounts.reserve(n * n);
+    uvSet.uvIds.reserve(n * n * 4);
+    for (unsigned int y = 0; y < n; ++y) {
+        for (unsigned int x = 0; x < n; ++x) {
+            const int a = static_cast<int>(y * (n + 1) + x);
+            const int quad[4] = { a, a + 1, a + static_cast<int>(n) + 2, a + static_cast<int>(n) + 1 };
+
+            const int copies = random.chance(rate) ? 2 : 1;
+            stats.doubleFaces += copies - 1;
+            for (int c = 0; c < copies; ++c) {
+                mesh.faceCounts.push_back(4);
+                mesh.faceConnects.insert(mesh.faceConnects.end(), quad, quad + 4);
+
+                if (random.chance(rate)) {
+                    ++stats.unmappedFaces;
+                    uvSet.uvCounts.push_back(0);
+                    continue;
+                }
+
+                uvSet.uvCounts.push_back(4);
+                if (random.chance(rate)) {
+                    ++stats.flippedUVFaces;
+                    uvSet.uvIds.insert(uvSet.uvIds.end(), { quad[3], quad[2], quad[1], quad[0] });
+                }
+                else if (random.chance(rate)) {
+                    // own uvs moved into -1 < u < 0, one tile, the winding stays.
+                    ++stats.negativeUVFaces;
+                    for (int i = 0; i < 4; ++i) {
+                        uvSet.uvIds.push_back(static_cast<int>(uvSet.u.size()));
+                        uvSet.u.push_back(uvSet.u[quad[i]] * 0.5f - 0.8f);
+                        uvSet.v.push_back(uvSet.v[quad[i]]);
+                    }
+                }
+                else {
+                    uvSet.uvIds.insert(uvSet.uvIds.end(), quad, quad + 4);
+                }
+            }
+        }
+    }
+    mesh.uvSets.push_back(uvSet);
+
+    mesh.normalLocked.assign(numVertices, 0);
+    if (random.chance(rate)) {
+        ++stats.normalLockMeshes;
+        mesh.normalLocked[random.below(numVertices)] = 1;
+    }
+
+    mesh.tweaks.assign(numVertices * 3, 0.0f);
+    if (random.chance(rate)) {
+        ++stats.freezeMeshes;
+        mesh.tweaks[random.below(numVertices * 3)] = 0.1f;
+    }
+}
+
+inline void generateMeshes(
+    const GeneratorOptions& options,
+    std::vector<MeshData>& meshes,
+    GeneratorStats& stats
+) {
+    GeneratorRandom random(options.seed);
+    const unsigned int resolution = static_cast<unsigned int>(std::sqrt((double)options.facesPerMesh) + 0.5);
+
+    meshes.resize(options.numMeshes);
+    for (unsigned int i = 0; i < options.numMeshes; ++i) {
+        generateMesh("mesh" + std::to_string(i), resolution, options, random, stats, meshes[i]);
+    }
+}
+
+inline void generateCurves(
+    const GeneratorOptions& options,
+    std::vector<CurveData>& curves,
+    GeneratorStats& stats
+) {
+    GeneratorRandom random(options.seed ^ 0xC0FFEEull);
+    const double rate = options.defectRate;
+    const unsigned int numCVs = std::max(4u, options.cvsPerCurve);
+
+    curves.resize(options.numCurves);
+    for (unsigned int c = 0; c < options.numCurves; ++c) {
+        CurveData& curve = curves[c];
+        curve.name = "curve" + std::to_string(c);
+        curve.cvs.resize(numCVs * 3);
+
+        // cvs on a random walk, fractional positions keep curves apart.
+        double x = random.uniform() * 1000.0;
+        double y = random.uniform() * 1000.0;
+        double z = random.uniform() * 1000.0;
+        for (unsigned int i = 0; i < numCVs; ++i) {
+            curve.cvs[i * 3 + 0] = x;
+            curve.cvs[i * 3 + 1] = y;
+            curve.cvs[i * 3 + 2] = z;
+            x += 0.5 + random.uniform();
+            y += random.uniform() - 0.5;
+            z += random.uniform() - 0.5;
+        }
+        // degree 3 open curve.
+        curve.numSpans = static_cast<int>(numCVs) - 3;
+
+        if (random.chance(rate)) {
+            ++stats.spans0Curves;
+            curve.numSpans = 0;
+        }
+
+        if (c > 0 && random.chance(rate)) {
+            ++stats.samePositionCurves;
+            const CurveData& other = curves[random.below(c)];
+            const unsigned int from = random.below(numCVs);
+            const unsigned int to = random.below(numCVs);
+            for (int k = 0; k < 3; ++k) {
+                curve.cvs[to * 3 + k] = other.cvs[from * 3 + k];
+            }
+        }
+    }
+}
+
+// Write meshes as OBJ, to load them into Maya or modelcheck.
+inline bool writeObj(const std::string& path, const std::vector<MeshData>& meshes) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    size_t vertexBase = 1;
+    size_t uvBase = 1;
+    for (const auto& mesh : meshes) {
+        fprintf(file, "o %s\n", mesh.name.c_str());
+        for (size_t i = 0; i < mesh.points.size(); i += 3) {
+            fprintf(file, "v %.9g %.9g %.9g\n", mesh.points[i], mesh.points[i + 1], mesh.points[i + 2]);
+        }
+        const UVSetData* uvSet = mesh.uvSets.empty() ? nullptr : &mesh.uvSets[0];
+        if (uvSet != nullptr) {
+            for (size_t i = 0; i < uvSet->u.size(); ++i) {
+                fprintf(file, "vt %.9g %.9g\n", uvSet->u[i], uvSet->v[i]);
+            }
+        }
+
+        size_t connect = 0;
+        size_t uvConnect = 0;
+        for (size_t f = 0; f < mesh.faceCounts.size(); ++f) {
+            const int count = mesh.faceCounts[f];
+            const bool mapped = uvSet != nullptr && uvSet->uvCounts[f] > 0;
+            fputc('f', file);
+            for (int i = 0; i < count; ++i) {
+                if (mapped) {
+                    fprintf(file, " %zu/%zu", vertexBase + mesh.faceConnects[connect + i], uvBase + uvSet->uvIds[uvConnect + i]);
+                }
+                else {
+                    fprintf(file, " %zu", vertexBase + mesh.faceConnects[connect + i]);
+                }
+            }
+            fputc('\n', file);
+            connect += count;
+            uvConnect += mapped ? count : 0;
+        }
+
+        vertexBase += mesh.points.size() / 3;
+        uvBase += uvSet != nullptr ? uvSet->u.size() : 0;
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,192 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Cost weighted work stealing scheduler.
+//
+// Items are sorted by estimated cost and dealt largest first to the worker
+// with the least work so far. A worker pops its own queue from the front
+// (largest remaining item) and, once empty, steals from the back of the
+// other queues. The scheduler does not own threads: the Maya side runs one
+// MThreadPool task per worker, the CLI runs one std::thread per worker.
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+// Rough cost of checking one mesh. numUVSets is the number of uv sets the
+// uv checks will look at.
+inline double estimateMeshCost(
+    const unsigned int numFaces,
+    const unsigned int numFaceVertices,
+    const unsigned int numUVSets
+) {
+    // fixed part covers binding the mesh through the API.
+    return 64.0 + numFaces + (double)numFaceVertices * (1 + numUVSets);
+}
+
+struct WorkerStats
+{
+    WorkerStats() : items(0), stolen(0), cost(0.0), busySec(0.0) {}
+
+    unsigned int items;
+    unsigned int stolen;
+    double cost;
+    double busySec;
+};
+
+class WorkScheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    WorkScheduler() : _wallSec(0.0) {}
+
+    // Deal items 0..costs.size()-1 to numWorkers queues.
+    void reset(const std::vector<double>& costs, const unsigned int numWorkers) {
+        const unsigned int workers = std::max(1u, numWorkers);
+        _costs = costs;
+        _queues = std::vector<Queue>(workers);
+        _stats = std::vector<WorkerStats>(workers);
+        _wallSec = 0.0;
+
+        std::vector<unsigned int> order(costs.size());
+        for (unsigned int i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+            return costs[a] > costs[b];
+        });
+
+        // least loaded worker first.
+        typedef std::pair<double, unsigned int> Load;
+        std::priority_queue<Load, std::vector<Load>, std::greater<Load>> loads;
+        for (unsigned int w = 0; w < workers; ++w) {
+            loads.push(Load(0.0, w));
+        }
+        for (const auto& item : order) {
+            Load load = loads.top();
+            loads.pop();
+            _queues[load.second].items.push_back(item);
+            load.first += costs[item];
+            loads.push(load);
+        }
+    }
+
+    unsigned int numWorkers() const {
+        return static_cast<unsigned int>(_queues.size());
+    }
+
+    // Get the next item for worker. Returns false when no work is left.
+    bool next(const unsigned int worker, unsigned int& item) {
+        {
+            Queue& own = _queues[worker];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.items.empty()) {
+                item = own.items.front();
+                own.items.pop_front();
+                count(worker, item, false);
+                return true;
+            }
+        }
+
+        const unsigned int workers = numWorkers();
+        for (unsigned int i = 1; i < workers; ++i) {
+            Queue& victim = _queues[(worker + i) % workers];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.items.empty()) {
+                item = victim.items.back();
+                victim.items.pop_back();
+                count(worker, item, true);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Run body(worker, item) until every queue is empty and record how long
+    // worker was busy.
+    template<typename Body>
+    void work(const unsigned int worker, Body body) {
+        const auto start = Clock::now();
+        unsigned int item;
+        while (next(worker, item)) {
+            if (!body(worker, item)) {
+                break;
+            }
+        }
+        _stats[worker].busySec = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Wall time of the whole parallel region, used for utilization.
+    void setWallTime(const double sec) {
+        _wallSec = sec;
+    }
+
+    double wallTime() const {
+        return _wallSec;
+    }
+
+    const std::vector<WorkerStats>& stats() const {
+        return _stats;
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<unsigned int> items;
+    };
+
+    void count(const unsigned int worker, const unsigned int item, const bool stolen) {
+        WorkerStats& stats = _stats[worker];
+        stats.items += 1;
+        stats.stolen += stolen ? 1 : 0;
+        stats.cost += _costs[item];
+    }
+
+    std::vector<double> _costs;
+    std::vector<Queue> _queues;
+    std::vector<WorkerStats> _stats;
+    double _wallSec;
+};
+
+// One line per worker: items, stolen items, cost, busy time and the share
+// of the parallel region the worker was busy.
+template<typename Print>
+void printWorkerStats(const WorkScheduler& scheduler, Print print) {
+    const auto& stats = scheduler.stats();
+    char line[256];
+    for (unsigned int w = 0; w < stats.size(); ++w) {
+        const double usage = scheduler.wallTime() > 0.0 ? stats[w].busySec / scheduler.wallTime() * 100.0 : 0.0;
+        snprintf(line, sizeof(line),
+            "worker %u: %u items (%u stolen), cost %.0f, busy %.6f sec (%.1f%%)",
+            w, stats[w].items, stats[w].stolen, stats[w].cost, stats[w].busySec, usage);
+        print(line);
+    }
+}
@@ -0,0 +1,75 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Parallel for on the Maya thread pool, shared by the mesh and curve
+// checks. runMeshKernelsSplit and the curve kernels take it as their
+// parallelFor.
+
+#include <functional>
+#include <vector>
+#include <maya/MThreadPool.h>
+
+typedef struct _parallelForTaskTag {
+    const std::function<void(unsigned int)>* body;
+    unsigned int count;
+} ParallelForTask;
+
+typedef struct _parallelForTdTag {
+    const std::function<void(unsigned int)>* body;
+    unsigned int index;
+} ParallelForTdData;
+
+inline MThreadRetVal parallelForTd(void* data) {
+    ParallelForTdData* td = (ParallelForTdData*)data;
+    (*td->body)(td->index);
+    return (MThreadRetVal)0;
+}
+
+inline void parallelForRegion(void* data, MThreadRootTask* root) {
+    ParallelForTask* task = (ParallelForTask*)data;
+
+    std::vector<ParallelForTdData> threadData(task->count);
+    for (unsigned int i = 0; i < task->count; ++i) {
+        threadData[i].body = task->body;
+        threadData[i].index = i;
+
+        MThreadPool::createTask(parallelForTd, (void*)&threadData[i], root);
+    }
+
+    MThreadPool::executeAndJoin(root);
+}
+
+// parallelFor(count, body) on the Maya thread pool: calls body(i) for
+// every i in [0, count) and returns once all calls are done. The pool must
+// be initialized with MThreadPool::init.
+struct MThreadPoolFor
+{
+    void operator()(const unsigned int count, const std::function<void(unsigned int)>& body) const {
+        ParallelForTask task;
+        task.body = &body;
+        task.count = count;
+        MThreadPool::newParallelRegion(parallelForRegion, (void*)&task);
+    }
+};
@@ -0,0 +1,64 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#pragma once
+
+// Cells of the grids the tolerance searches snap positions to.
+//
+// A position is divided by twice the tolerance and floored on each axis.
+// Cells are clamped to +-kMaxGridCell, so a tiny tolerance or a far away
+// point can not overflow int64. The clamp keeps neighbour cells next to
+// each other, points past it only share the last cell. That is slower,
+// but still exact, as every candidate is compared by distance.
+
+#include <cmath>
+#include <cstdint>
+
+const int64_t kMaxGridCell = (int64_t)1 << 62;
+
+// Smallest tolerance the commands accept. 0 is exact matching.
+const double kMinTolerance = 1e-12;
+
+inline bool isValidTolerance(const double tolerance) {
+    return tolerance == 0.0 || (tolerance >= kMinTolerance && std::isfinite(tolerance));
+}
+
+// Cell of position, in cell units, on one axis, and the side of the
+// neighbour cell nearest to it, -1 or 1. NaN goes to the last cell.
+inline void snapGridCell(
+    const double position,
+    int64_t& cell, // out
+    int64_t& side // out
+) {
+    const double lower = std::floor(position);
+    side = position - lower < 0.5 ? -1 : 1;
+    if (!(lower < static_cast<double>(kMaxGridCell))) {
+        cell = kMaxGridCell;
+    }
+    else if (lower < -static_cast<double>(kMaxGridCell)) {
+        cell = -kMaxGridCell;
+    }
+    else {
+        cell = static_cast<int64_t>(lower);
+    }
+}
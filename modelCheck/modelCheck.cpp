@@ -0,0 +1,244 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include <stdio.h>
+#include <maya/MString.h>
+#include <maya/MStringArray.h>
+#include <maya/MFnPlugin.h>
+#include <maya/MPxCommand.h>
+#include <maya/MGlobal.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgList.h>
+#include <maya/MArgParser.h>
+#include <maya/MSelectionList.h>
+
+#include "../common/meshCheck.h"
+
+// modelCheck
+//
+// Runs several mesh checks in one pass over the scene.
+//
+//   modelCheck -check doubleFace -check uvFlip -uvSet "map1";
+//
+// -check accepts the command name (checkMeshUVFlip) or the short name
+// (uvFlip) and may be used multiple times. Without -check every mesh check
+// is run. The result is a flat string array of (check name, item) pairs.
+namespace
+{
+    // select argument
+    const char *selectArgName = "-s";
+    const char *selectLongArgName = "-select";
+
+    // check argument
+    const char *checkArgName = "-c";
+    const char *checkLongArgName = "-check";
+
+    // uv set argument
+    const char *uvSetArgName = "-uvs";
+    const char *uvSetLongArgName = "-uvSet";
+
+    // all uv set argument
+    const char *allUVSetArgName = "-all";
+    const char *allUVSetLongArgName = "-allUVSet";
+};
+
+class modelCheck : public MPxCommand
+{
+    public:
+        modelCheck();
+        virtual ~modelCheck();
+        MStatus doIt(const MArgList& args);
+        MStatus redoIt();
+        MStatus undoIt();
+        bool isUndoable() const;
+        static void* creator();
+        static MSyntax createSyntax();
+    private:
+        MSelectionList _beforeSelection;
+        MSelectionList _invalid;
+        MString        _profile;
+        MStringArray   _results;
+
+        bool _fIsSelect;
+};
+
+modelCheck::modelCheck()
+    : _beforeSelection()
+    , _invalid()
+    , _profile()
+    , _results()
+    , _fIsSelect(false)
+{
+}
+modelCheck::~modelCheck() {
+}
+
+MSyntax modelCheck::createSyntax() {
+    MSyntax syntax;
+
+    syntax.addFlag(selectArgName, selectLongArgName, MSyntax::kNoArg);
+    syntax.addFlag(checkArgName, checkLongArgName, MSyntax::kString);
+    syntax.makeFlagMultiUse(checkArgName);
+    syntax.addFlag(uvSetArgName, uvSetLongArgName, MSyntax::kString);
+    syntax.addFlag(allUVSetArgName, allUVSetLongArgName, MSyntax::kNoArg);
+    addMeshCheckFlags(syntax);
+    addDoubleFaceFlags(syntax);
+
+    return syntax;
+}
+
+MStatus modelCheck::doIt(const MArgList& args) {
+    MStatus stat = MStatus::kSuccess;
+
+    const auto parseStart = Profiler::now();
+    MArgParser argData(syntax(), args, &stat);
+    CheckDisplayError(stat, "doIt: argument syntax error.");
+    MeshCheckTask taskData;
+
+    if (argData.isFlagSet(selectArgName)) {
+        _fIsSelect = true;
+        MGlobal::getActiveSelectionList(_beforeSelection);
+    }
+
+    if (argData.isFlagSet(allUVSetArgName)) {
+        taskData.allUVSet = true;
+    }
+
+    if (argData.isFlagSet(uvSetArgName)) {
+        stat = argData.getFlagArgument(uvSetArgName, 0, taskData.uvSet);
+        CheckDisplayError(stat, "doIt: could not get uvSet argument data.");
+    }
+
+    bool enabled[kMeshCheckCount] = {};
+    const unsigned int numChecks = argData.numberOfFlagUses(checkArgName);
+    for (unsigned int i = 0; i < numChecks; ++i) {
+        MArgList checkArgs;
+        stat = argData.getFlagArgumentList(checkArgName, i, checkArgs);
+        CheckDisplayError(stat, "doIt: could not get check argument list.");
+
+        MString checkName = checkArgs.asString(0, &stat);
+        CheckDisplayError(stat, "doIt: could not get check argument data.");
+
+        MeshCheckKind kind;
+        if (!findMeshCheck(checkName.asChar(), kind)) {
+            MGlobal::displayError("doIt: unknown check " + checkName + ".");
+            return MStatus::kInvalidParameter;
+        }
+        enabled[kind] = true;
+    }
+
+    for (int k = 0; k < kMeshCheckCount; ++k) {
+        if (enabled[k] || numChecks == 0) {
+            taskData.checks.push_back(static_cast<MeshCheckKind>(k));
+        }
+    }
+
+    stat = parseMeshCheckFlags(argData, taskData);
+    CheckDisplayError(stat, "doIt: could not parse mesh check flags.");
+
+    stat = parseDoubleFaceFlags(argData, taskData);
+    CheckDisplayError(stat, "doIt: could not parse double face flags.");
+    taskData.profiler.addStage("parse", parseStart);
+
+    // ======================================================================
+    // step 1, 2
+    stat = runMeshChecks(taskData);
+    CheckDisplayError(stat, "doIt: runMeshChecks error.");
+
+    // ======================================================================
+    // tag results by check.
+    MStringArray selectionStrings;
+    for (const auto& kind : taskData.checks) {
+        const MSelectionList& invalidList = taskData.invalidLists[kind];
+        if (invalidList.length() == 0) {
+            continue;
+        }
+
+        selectionStrings.clear();
+        stat = invalidList.getSelectionStrings(selectionStrings);
+        CheckDisplayError(stat, "doIt: invalid.getSelectionStrings is failed.");
+
+        const MString checkName(meshCheckName(kind));
+        for (unsigned int i = 0; i < selectionStrings.length(); ++i) {
+            _results.append(checkName);
+            _results.append(selectionStrings[i]);
+        }
+
+        stat = _invalid.merge(invalidList);
+        CheckDisplayError(stat, "doIt: could not merge invalid list.");
+    }
+
+    if (taskData.profiler.enabled()) {
+        stat = getProfileResult(taskData, _profile);
+        CheckDisplayError(stat, "doIt: could not get profile result.");
+    }
+
+    stat = redoIt();
+
+    return stat;
+}
+
+MStatus modelCheck::redoIt() {
+    if (_fIsSelect) {
+        MStatus stat = MGlobal::setActiveSelectionList(_invalid);
+        return stat;
+    }
+    if (_profile.length() > 0) {
+        setResult(_profile);
+        return MStatus::kSuccess;
+    }
+
+    setResult(_results);
+    return MStatus::kSuccess;
+}
+
+MStatus modelCheck::undoIt() {
+    if (_fIsSelect) {
+        MStatus stat = MGlobal::setActiveSelectionList(_beforeSelection);
+        return stat;
+    }
+    return MStatus::kSuccess;
+}
+
+bool modelCheck::isUndoable() const {
+    return true;
+}
+
+void* modelCheck::creator() {
+    return new modelCheck();
+}
+
+MStatus initializePlugin(MObject obj)
+{
+    MFnPlugin plugin(obj, "nrtkbb", "1.0", "Any");
+    plugin.registerCommand("modelCheck",
+        modelCheck::creator, modelCheck::createSyntax);
+    return MS::kSuccess;
+}
+MStatus uninitializePlugin(MObject obj)
+{
+    MFnPlugin plugin( obj );
+    plugin.deregisterCommand("modelCheck");
+    meshCheckCache().clear();
+    return MS::kSuccess;
+}
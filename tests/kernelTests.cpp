@@ -0,0 +1,242 @@
+/*
+MIT License
+
+Copyright (c) 2020 nrtkbb
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+// kernelTests
+//
+// Cases of the Maya independent kernels that generated scenes do not hit.
+// Prints every failed case and exits with the number of failures.
+//
+//   g++ -std=c++14 -O2 -o kernelTests tests/kernelTests.cpp && ./kernelTests
+
+#include <stdio.h>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../common/crossMesh.h"
+#include "../common/meshKernels.h"
+
+namespace
+{
+    int failures = 0;
+
+    void expect(const bool ok, const std::string& name) {
+        if (!ok) {
+            printf("FAILED %s\n", name.c_str());
+            ++failures;
+        }
+    }
+
+    // One mesh of the faces in points, every face with its own vertices.
+    MeshData makeFaces(const std::vector<std::vector<float>>& faces) {
+        MeshData mesh;
+        for (const auto& face : faces) {
+            const int count = static_cast<int>(face.size() / 3);
+            mesh.faceCounts.push_back(count);
+            for (int v = 0; v < count; ++v) {
+                mesh.faceConnects.push_back(static_cast<int>(mesh.points.size() / 3));
+                mesh.points.insert(mesh.points.end(), face.begin() + v * 3, face.begin() + v * 3 + 3);
+            }
+        }
+        return mesh;
+    }
+
+    std::vector<float> shifted(std::vector<float> face, const float dx) {
+        for (size_t i = 0; i < face.size(); i += 3) {
+            face[i] += dx;
+        }
+        return face;
+    }
+
+    // Whether faces 0 and 1 of mesh are near double faces, every pair
+    // compared.
+    bool nearPair(const MeshData& mesh, const double tolerance) {
+        const MeshView view = mesh.view();
+        const int count = mesh.faceCounts[0];
+        const int* connectB = view.faceConnects + count;
+        const double tolerance2 = tolerance * tolerance;
+        return mesh.faceCounts[1] == count
+            && faceVerticesWithin(view, view.faceConnects, connectB, count, tolerance2)
+            && faceVerticesWithin(view, connectB, view.faceConnects, count, tolerance2);
+    }
+
+    std::vector<int> doubleFaces(const MeshData& mesh, const double tolerance) {
+        MeshKernelOptions options;
+        options.tolerance = tolerance;
+        MeshKernelScratch scratch;
+        MeshCheckResult result;
+        runMeshKernels(mesh.view(), { kMeshDoubleFace }, {}, options, scratch, result);
+        return result.faces[kMeshDoubleFace];
+    }
+
+    // Near double faces whose vertices are bunched at opposite ends: their
+    // centers are about 1.98 apart with a tolerance of 1. Moved across
+    // every cell boundary of the grid.
+    void testDoubleFaceToleranceShift() {
+        const std::vector<float> a = { 0.0f, 0.0f, 0.0f, 0.01f, 0.05f, 0.0f, 0.02f, 0.0f, 0.0f, 2.0f, 0.0f, 0.0f };
+        const std::vector<float> b = { 1.0f, 0.0f, 0.0f, 2.98f, 0.05f, 0.0f, 2.99f, 0.0f, 0.0f, 3.0f, 0.0f, 0.0f };
+        std::vector<float> far = b;
+        far[0] = 1.1f;
+
+        // 1.001 keeps the pair near after the float shift.
+        const double tolerance = 1.001;
+        for (int step = 0; step <= 400; ++step) {
+            const float dx = step * 0.01f - 1.0f;
+            const std::string name = "doubleFaceTolerance shift " + std::to_string(dx);
+            const MeshData pair = makeFaces({ shifted(a, dx), shifted(b, dx) });
+            expect(nearPair(pair, tolerance) && !doubleFaces(pair, tolerance).empty(), name);
+            const MeshData swapped = makeFaces({ shifted(b, dx), shifted(a, dx) });
+            expect(!doubleFaces(swapped, tolerance).empty(), name + " swapped");
+            const MeshData apart = makeFaces({ shifted(a, dx), shifted(far, dx) });
+            expect(!nearPair(apart, tolerance) && doubleFaces(apart, tolerance).empty(), name + " far");
+        }
+    }
+
+    // Faces exactly tolerance apart, on both sides of a cell boundary and
+    // far from the origin. The offsets are exact in float.
+    void testDoubleFaceToleranceExact() {
+        const std::vector<float> a = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+        const float offsets[] = { 0.0f, 0.125f, 0.25f, 0.375f, 1024.0f, 1048576.0f };
+        for (const float offset : offsets) {
+            const std::string name = "doubleFaceTolerance exact " + std::to_string(offset);
+            expect(!doubleFaces(makeFaces({ shifted(a, offset), shifted(a, offset + 0.25f) }), 0.25).empty(), name);
+            expect(doubleFaces(makeFaces({ shifted(a, offset), shifted(a, offset + 0.5f) }), 0.25).empty(), name + " apart");
+        }
+    }
+
+    // NaN, infinite and out of int range uvs at the SSE2 positions (the
+    // first 4) and at the scalar tail. Both get kUVTileOutside, and the
+    // UDIM report counts them as outside.
+    void testUVTilesOutside() {
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const float infinity = std::numeric_limits<float>::infinity();
+        const float values[] = { nan, 1e10f, -1e10f, infinity, -infinity, 2147483648.0f };
+        const int count = 7;
+        for (const float value : values) {
+            for (int position = 0; position < count; ++position) {
+                const std::string name = "uvTile " + std::to_string(value) + " at " + std::to_string(position);
+                std::vector<float> u(count, 0.5f);
+                u[position] = value;
+                u[(position + 1) % count] = -0.5f;
+
+                std::vector<int> tiles(count);
+                floorUVTiles(u.data(), count, tiles.data());
+                bool ok = tiles[position] == kUVTileOutside;
+                for (int i = 0; i < count; ++i) {
+                    if (i != position) {
+                        ok = ok && tiles[i] == (u[i] < 0.0f ? -1 : 0);
+                    }
+                }
+                expect(ok, name);
+
+                MeshData mesh = makeFaces({ std::vector<float>(count * 3, 0.0f) });
+                UVSetData uvSet;
+                uvSet.u = u;
+                uvSet.u[(position + 1) % count] = 0.5f;
+                uvSet.v.assign(count, 0.5f);
+                uvSet.uvCounts.push_back(count);
+                for (int i = 0; i < count; ++i) {
+                    uvSet.uvIds.push_back(i);
+                }
+                mesh.uvSets.push_back(uvSet);
+                const MeshView view = mesh.view();
+                MeshKernelScratch scratch;
+                UDIMReport report;
+                searchUVTilingOver(view, view.uvSets[0], scratch, &report);
+                expect(report.outside, name + " outside");
+            }
+        }
+        const float lowest = -2147483648.0f;
+        int tile = 0;
+        floorUVTiles(&lowest, 1, &tile);
+        expect(tile == INT_MIN, "uvTile lowest");
+    }
+
+    // A row of quads from x, sharing their vertices.
+    MeshData quadRow(const int numQuads, const float x) {
+        MeshData mesh;
+        for (int i = 0; i <= numQuads; ++i) {
+            mesh.points.insert(mesh.points.end(), { x + i, 0.0f, 0.0f, x + i, 1.0f, 0.0f });
+        }
+        for (int i = 0; i < numQuads; ++i) {
+            mesh.faceCounts.push_back(4);
+            mesh.faceConnects.insert(mesh.faceConnects.end(), { i * 2, i * 2 + 2, i * 2 + 3, i * 2 + 1 });
+        }
+        return mesh;
+    }
+
+    // Instances moved onto each other by their world matrix, in a table
+    // sized too small so its shards grow.
+    void testCrossMeshInstances() {
+        const int numQuads = 300;
+        const MeshData a = quadRow(numQuads, 0.0f);
+        const MeshData b = quadRow(numQuads, 8.0f);
+        MeshData c = quadRow(numQuads, 0.0f);
+        c.faceCounts.push_back(3);
+        c.faceConnects.insert(c.faceConnects.end(), { 0, 2, 1 });
+        const MeshView viewA = a.view();
+        const MeshView viewB = b.view();
+        const MeshView viewC = c.view();
+
+        // row vectors: translate x by -8, and scale by 2 then translate.
+        const double back[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -8, 0, 0, 1 };
+        const double apart[16] = { 2, 0, 0, 0, 0, 2, 0, 0, 0, 0, 2, 0, 0, 0, 4, 1 };
+
+        CrossMeshTable table(4);
+        table.reserve(0, 0);
+        CrossMeshScratch scratch;
+        std::vector<CrossMeshHit> hits;
+        table.search(viewA, nullptr, 0, scratch, hits);
+        expect(hits.empty(), "crossMesh first");
+
+        table.search(viewB, back, 1, scratch, hits);
+        expect(hits.size() == 2 && hits[0].mesh == 1 && hits[0].face == -1 && hits[1].mesh == 0 && hits[1].face == -1,
+            "crossMesh instance shape");
+
+        hits.clear();
+        table.search(viewC, apart, 2, scratch, hits);
+        expect(hits.empty(), "crossMesh apart");
+
+        table.search(viewC, nullptr, 2, scratch, hits);
+        bool faces = hits.size() == numQuads * 2;
+        for (size_t h = 0; faces && h < hits.size(); h += 2) {
+            faces = hits[h].mesh == 2 && hits[h + 1].mesh == 0 && hits[h].face == hits[h + 1].face;
+        }
+        expect(faces, "crossMesh instance faces");
+
+        hits.clear();
+        table.search(viewC, apart, 2, scratch, hits);
+        expect(hits.size() == 2 && hits[0].mesh == 2 && hits[1].mesh == 2, "crossMesh same instance");
+    }
+}
+
+int main() {
+    testDoubleFaceToleranceShift();
+    testDoubleFaceToleranceExact();
+    testUVTilesOutside();
+    testCrossMeshInstances();
+
+    printf("kernelTests: %d failures.\n", failures);
+    return failures;
+}